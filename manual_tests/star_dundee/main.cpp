@@ -8,6 +8,7 @@
 #include <catch_reporter_tap.hpp>
 #include <catch_reporter_teamcity.hpp>
 #endif
+#include "BridgePlugins.hpp"
 #include "SpaceWireBridges.hpp"
 #include "SpaceWireZMQ.hpp"
 #include "ZMQClient.hpp"
@@ -70,6 +71,7 @@ TEST_CASE("ZMQ Server", "[]")
     std::vector<unsigned char> ref_data(bucket_count * bucket_size);
     std::generate(std::begin(ref_data), std::end(ref_data), []() mutable { return rand(); });
     std::vector<spw_packet> loopback_packets;
+    REQUIRE(BridgePlugins::load(STARDUNDEE_PLUGIN));
     ZMQServer server { {} };
     auto _ = SpaceWireBridges::setup(
         config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
@@ -0,0 +1,94 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include "MockBridge.hpp"
+#include "SpaceWireBridges.hpp"
+#include "SpaceWireZMQ.hpp"
+#include "ZMQClient.hpp"
+#include "ZMQServer.hpp"
+#include "config/Config.hpp"
+#include "config/yaml_io.hpp"
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Compares request and publish latencies of the available transports, the Mock bridge loops
+ * back packets addressed to logical address 1 so they get published to the client.
+ *  - request: client.send_packet returns once the server acknowledged the packet
+ *  - request + publish: the packet goes to the bridge and comes back to the client
+ */
+
+spw_packet ccsds_packet(bool loopback)
+{
+    spw_packet packet { 64, 0, "Mock" };
+    spacewire::fields::destination_logical_address(packet.data.data()) = loopback ? 1 : 0;
+    spacewire::fields::protocol_identifier(packet.data.data())
+        = spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS;
+    return packet;
+}
+
+template <typename client_t>
+void run_benchmarks(const std::string& transport, client_t& client)
+{
+    BENCHMARK(transport + " request")
+    {
+        client.send_packet(ccsds_packet(false));
+    };
+    BENCHMARK(transport + " request + publish")
+    {
+        client.send_packet(ccsds_packet(true));
+        return client.next_packet();
+    };
+}
+
+TEST_CASE("Transport latency", "[]")
+{
+    SECTION("tcp")
+    {
+        ZMQServer server { from_yaml("transport: tcp") };
+        auto _ = SpaceWireBridges::setup(
+            config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
+        std::this_thread::sleep_for(5ms);
+        {
+            ZMQClient client { { topics::types::CCSDS }, server.configuration(),
+                topic_policy::merge_all_topics {} };
+            run_benchmarks("tcp", client);
+        }
+        server.close();
+    }
+    SECTION("ipc")
+    {
+        ZMQServer server { from_yaml("transport: ipc") };
+        auto _ = SpaceWireBridges::setup(
+            config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
+        std::this_thread::sleep_for(5ms);
+        {
+            ZMQClient client { { topics::types::CCSDS }, server.configuration(),
+                topic_policy::merge_all_topics {} };
+            run_benchmarks("ipc", client);
+        }
+        server.close();
+    }
+    SECTION("inproc")
+    {
+        ZMQServer server { from_yaml("transport: inproc") };
+        auto _ = SpaceWireBridges::setup(
+            config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
+        {
+            ZMQClient client { { topics::types::CCSDS }, server.configuration(),
+                server.context(), topic_policy::merge_all_topics {} };
+            run_benchmarks("inproc", client);
+        }
+        server.close();
+    }
+}
@@ -0,0 +1,114 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#ifndef SPACEWIREZMQ_BRIDGE_PLUGIN_H
+#define SPACEWIREZMQ_BRIDGE_PLUGIN_H
+/*
+ * C ABI of bridge plugins, shared objects the server loads at runtime (see BridgePlugins.hpp)
+ * so sites with different hardware use the same server binary. Only C types cross the
+ * boundary, a plugin can be built with any compiler and standard library.
+ *
+ * A plugin exports SPW_BRIDGE_PLUGIN_ENTRY returning a spw_bridge_plugin that lives as long
+ * as the shared object. Each bridge instance of the configuration with a matching type
+ * (see SpaceWireBridges) gets its own create call, packets are then exchanged from two host
+ * threads, one calling packet_received/receive_packet and the other one send_packet.
+ */
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPW_BRIDGE_PLUGIN_ABI_VERSION 1
+#define SPW_BRIDGE_PLUGIN_ENTRY "spacewirezmq_bridge_plugin"
+
+/* bridge instance configuration, only valid during the call it is given to */
+typedef struct spw_bridge_config spw_bridge_config;
+
+typedef struct spw_bridge_packet
+{
+    const unsigned char* data;
+    size_t size;
+    size_t port;
+} spw_bridge_packet;
+
+typedef enum spw_bridge_event_kind
+{
+    SPW_BRIDGE_EVENT_TIME_CODE = 0,
+    SPW_BRIDGE_EVENT_LINK_UP = 1,
+    SPW_BRIDGE_EVENT_LINK_DOWN = 2,
+    SPW_BRIDGE_EVENT_ERRORS = 3
+} spw_bridge_event_kind;
+
+typedef struct spw_bridge_event
+{
+    uint8_t kind; /* spw_bridge_event_kind */
+    uint8_t time_code;
+    size_t port;
+    uint32_t parity_errors;
+    uint32_t disconnect_errors;
+    uint32_t credit_errors;
+    uint32_t escape_errors;
+} spw_bridge_event;
+
+/*
+ * Services the server gives to plugins. Configuration keys can be paths ("link.speed"),
+ * getters return default_value when the key is missing or has another type.
+ */
+typedef struct spw_bridge_host
+{
+    int (*config_bool)(const spw_bridge_config* config, const char* key, int default_value);
+    int (*config_int)(const spw_bridge_config* config, const char* key, int default_value);
+    double (*config_double)(
+        const spw_bridge_config* config, const char* key, double default_value);
+    /* copies the string and its terminating zero if it fits, returns its length */
+    size_t (*config_string)(const spw_bridge_config* config, const char* key, char* buffer,
+        size_t buffer_size);
+    /* thread safe, may be called from any plugin thread */
+    void (*publish_event)(void* host_context, const spw_bridge_event* event);
+    void* host_context;
+} spw_bridge_host;
+
+typedef struct spw_bridge_plugin
+{
+    uint32_t abi_version; /* SPW_BRIDGE_PLUGIN_ABI_VERSION */
+    const char* type;     /* bridge type, for example "UDP" */
+    /* host stays valid until destroy, returns NULL on failure */
+    void* (*create)(const spw_bridge_host* host, const spw_bridge_config* config);
+    void (*destroy)(void* bridge);
+    /* returns non zero on success */
+    int (*send_packet)(void* bridge, const spw_bridge_packet* packet);
+    /* returns non zero when receive_packet has a packet */
+    int (*packet_received)(void* bridge);
+    /* packet data stays valid until the next call on this bridge, returns non zero on success */
+    int (*receive_packet)(void* bridge, spw_bridge_packet* packet);
+    /* may be NULL, returns non zero on success */
+    int (*set_configuration)(void* bridge, const spw_bridge_config* config);
+} spw_bridge_plugin;
+
+typedef const spw_bridge_plugin* (*spw_bridge_plugin_entry)(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,133 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "BridgePlugin.h"
+#include "PacketQueue.hpp"
+#include "SpaceWireBridge.hpp"
+#include "config/Config.hpp"
+#include <exception>
+#include <spdlog/spdlog.h>
+#include <thread>
+#include <vector>
+
+/*
+ * Exposes an ISpaceWireBridge through the plugin C ABI (see BridgePlugin.h), for C++ bridges
+ * depending on vendor libraries the server shouldn't link:
+ *   const auto plugin = bridge_plugin_adapter<MyBridge>::plugin("MyBridge");
+ *   extern "C" const spw_bridge_plugin* spacewirezmq_bridge_plugin(void) { return &plugin; }
+ * Unlike C plugins, the bridge gets the host Config itself, so the plugin must be built with
+ * the same toolchain and dependencies as the server.
+ */
+template <typename Bridge>
+struct bridge_plugin_adapter
+{
+    struct instance
+    {
+        const spw_bridge_host* host;
+        // the bridge publishes here and a thread forwards to the host, Bridge never waits
+        event_queue events;
+        Bridge bridge;
+        std::thread forwarder;
+        // returned data stays valid until the next receive_packet call
+        spw_packet received;
+
+        instance(const spw_bridge_host* host, const Config& cfg) : host { host }, bridge { cfg }
+        {
+            bridge.set_event_queue(&events, "");
+            forwarder = std::thread(&instance::forward_events, this);
+        }
+
+        ~instance()
+        {
+            events.close();
+            forwarder.join();
+        }
+
+        void forward_events()
+        {
+            while (auto event = events.take())
+            {
+                spw_bridge_event e {};
+                e.kind = static_cast<uint8_t>(event->kind);
+                e.time_code = event->time_code;
+                e.port = event->port;
+                e.parity_errors = event->errors.parity;
+                e.disconnect_errors = event->errors.disconnect;
+                e.credit_errors = event->errors.credit;
+                e.escape_errors = event->errors.escape;
+                host->publish_event(host->host_context, &e);
+            }
+        }
+    };
+
+    static inline const Config& config(const spw_bridge_config* config)
+    {
+        return *reinterpret_cast<const Config*>(config);
+    }
+
+    static void* create(const spw_bridge_host* host, const spw_bridge_config* cfg)
+    {
+        // exceptions can't cross the C ABI
+        try
+        {
+            return new instance { host, config(cfg) };
+        }
+        catch (const std::exception& e)
+        {
+            spdlog::error("Bridge plugin creation failed: {}", e.what());
+            return nullptr;
+        }
+    }
+
+    static void destroy(void* bridge) { delete static_cast<instance*>(bridge); }
+
+    static int send_packet(void* bridge, const spw_bridge_packet* packet)
+    {
+        return static_cast<instance*>(bridge)->bridge.send_packet(spw_packet {
+            std::vector<unsigned char>(packet->data, packet->data + packet->size), packet->port,
+            "" });
+    }
+
+    static int packet_received(void* bridge)
+    {
+        return static_cast<instance*>(bridge)->bridge.packet_received();
+    }
+
+    static int receive_packet(void* bridge, spw_bridge_packet* packet)
+    {
+        auto self = static_cast<instance*>(bridge);
+        self->received = self->bridge.receive_packet();
+        *packet = { self->received.data.data(), self->received.size(), self->received.port };
+        return 1;
+    }
+
+    static int set_configuration(void* bridge, const spw_bridge_config* cfg)
+    {
+        return static_cast<instance*>(bridge)->bridge.set_configuration(config(cfg));
+    }
+
+    static constexpr spw_bridge_plugin plugin(const char* type)
+    {
+        return { SPW_BRIDGE_PLUGIN_ABI_VERSION, type, create, destroy, send_packet,
+            packet_received, receive_packet, set_configuration };
+    }
+};
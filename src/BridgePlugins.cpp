@@ -0,0 +1,225 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#include "BridgePlugins.hpp"
+#include "BridgePlugin.h"
+#include "PacketQueue.hpp"
+#include "SpaceWireBridge.hpp"
+#include "SpaceWireBridges.hpp"
+#include "config/Config.hpp"
+#include <algorithm>
+#include <cstring>
+#include <dlfcn.h>
+#include <memory>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+
+Config node(const spw_bridge_config* config, const char* key)
+{
+    // spw_bridge_config is opaque for plugins, it is the bridge Config on this side
+    // looked up on a copy since operator[] inserts the missing keys
+    Config current = *reinterpret_cast<const Config*>(config);
+    std::string_view path { key };
+    while (true)
+    {
+        const auto dot = path.find('.');
+        Config child = current[std::string { path.substr(0, dot) }];
+        if (dot == std::string_view::npos)
+            return child;
+        current = child;
+        path.remove_prefix(dot + 1);
+    }
+}
+
+int config_bool(const spw_bridge_config* config, const char* key, int default_value)
+{
+    return node(config, key).to<bool>(default_value != 0);
+}
+
+int config_int(const spw_bridge_config* config, const char* key, int default_value)
+{
+    return node(config, key).to<int>(default_value);
+}
+
+double config_double(const spw_bridge_config* config, const char* key, double default_value)
+{
+    return to_double(node(config, key), default_value);
+}
+
+std::size_t config_string(
+    const spw_bridge_config* config, const char* key, char* buffer, std::size_t buffer_size)
+{
+    const auto value = node(config, key).to<std::string>("");
+    if (buffer && std::size(value) < buffer_size)
+        std::memcpy(buffer, value.c_str(), std::size(value) + 1);
+    return std::size(value);
+}
+
+// adapts a plugin bridge instance to ISpaceWireBridge
+class PluginBridge : public ISpaceWireBridge
+{
+    const spw_bridge_plugin* m_plugin;
+    spw_bridge_host m_host;
+    Config m_cfg;
+    void* m_bridge = nullptr;
+
+    inline spw_bridge_config* plugin_config()
+    {
+        return reinterpret_cast<spw_bridge_config*>(&m_cfg);
+    }
+
+    static void forward_event(void* host_context, const spw_bridge_event* event)
+    {
+        if (!event || event->kind > SPW_BRIDGE_EVENT_ERRORS)
+            return;
+        spw_event e;
+        e.kind = static_cast<spw_event::kind_t>(event->kind);
+        e.port = event->port;
+        e.time_code = event->time_code;
+        e.errors = { event->parity_errors, event->disconnect_errors, event->credit_errors,
+            event->escape_errors };
+        static_cast<PluginBridge*>(host_context)->publish_event(std::move(e));
+    }
+
+public:
+    PluginBridge(const spw_bridge_plugin* plugin, const Config& cfg)
+            : m_plugin { plugin }
+            , m_host { config_bool, config_int, config_double, config_string, forward_event,
+                this }
+            , m_cfg { cfg }
+    {
+        m_bridge = m_plugin->create(&m_host, plugin_config());
+        if (!m_bridge)
+            spdlog::error("Plugin bridge {} creation failed", m_plugin->type);
+    }
+
+    virtual ~PluginBridge()
+    {
+        if (m_bridge)
+            m_plugin->destroy(m_bridge);
+    }
+
+    virtual bool send_packet(const spw_packet& packet) final
+    {
+        const spw_bridge_packet p { packet.data.data(), packet.size(), packet.port };
+        return m_bridge && m_plugin->send_packet(m_bridge, &p);
+    }
+
+    virtual spw_packet receive_packet() final
+    {
+        spw_bridge_packet p { nullptr, 0, 0 };
+        if (m_bridge && m_plugin->receive_packet(m_bridge, &p) && p.data)
+            return spw_packet { std::vector<unsigned char>(p.data, p.data + p.size), p.port, "" };
+        return {};
+    }
+
+    virtual bool packet_received() final
+    {
+        return m_bridge && m_plugin->packet_received(m_bridge);
+    }
+
+    virtual bool set_configuration(const Config& cfg) final
+    {
+        m_cfg = cfg;
+        if (!m_bridge || !m_plugin->set_configuration)
+            return false;
+        return m_plugin->set_configuration(m_bridge, plugin_config());
+    }
+
+    virtual Config configuration() const final { return m_cfg; }
+};
+
+bool valid(const spw_bridge_plugin* plugin)
+{
+    return plugin && plugin->abi_version == SPW_BRIDGE_PLUGIN_ABI_VERSION && plugin->type
+        && plugin->create && plugin->destroy && plugin->send_packet && plugin->packet_received
+        && plugin->receive_packet;
+}
+
+}
+
+namespace BridgePlugins
+{
+
+bool load(const std::filesystem::path& path)
+{
+    auto handle = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!handle)
+    {
+        spdlog::error("Can't load bridge plugin {}: {}", path.string(), dlerror());
+        return false;
+    }
+    const auto entry
+        = reinterpret_cast<spw_bridge_plugin_entry>(dlsym(handle, SPW_BRIDGE_PLUGIN_ENTRY));
+    const spw_bridge_plugin* plugin = entry ? entry() : nullptr;
+    if (!valid(plugin))
+    {
+        spdlog::error("{} isn't a bridge plugin or was built for another ABI version",
+            path.string());
+        dlclose(handle);
+        return false;
+    }
+    if (SpaceWireBridges::has_ctor(plugin->type))
+        spdlog::warn("Bridge plugin {} replaces the built-in {} bridge", path.string(),
+            plugin->type);
+    // the handle is never closed, bridges may outlive any scope we could close it from
+    SpaceWireBridges::register_ctor(plugin->type,
+        [plugin](const std::string& name, const Config& cfg, packet_queue* publish_queue) {
+            return std::make_unique<SpaceWireBridge>(
+                std::make_unique<PluginBridge>(plugin, cfg), publish_queue, name);
+        });
+    spdlog::info("Loaded {} bridge plugin from {}", plugin->type, path.string());
+    return true;
+}
+
+std::size_t load_directory(const std::filesystem::path& directory)
+{
+    std::error_code ec;
+    std::vector<std::filesystem::path> paths;
+    for (const auto& entry : std::filesystem::directory_iterator { directory, ec })
+    {
+        if (entry.is_regular_file() && entry.path().extension() == ".so")
+            paths.push_back(entry.path());
+    }
+    if (ec)
+    {
+        spdlog::error("Can't list bridge plugins in {}: {}", directory.string(), ec.message());
+        return 0;
+    }
+    // sorted so the load order doesn't depend on the file system
+    std::sort(std::begin(paths), std::end(paths));
+    return std::count_if(std::cbegin(paths), std::cend(paths), load);
+}
+
+std::size_t setup(Config cfg)
+{
+    const auto directory = cfg["directory"].to<std::string>("");
+    if (std::empty(directory))
+        return 0;
+    return load_directory(directory);
+}
+
+}
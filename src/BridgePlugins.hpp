@@ -0,0 +1,44 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "config/Config.hpp"
+#include <cstddef>
+#include <filesystem>
+
+/*
+ * Bridge plugins (see BridgePlugin.h) are loaded before the bridges are set up:
+ *   plugins:
+ *     directory: /opt/spacewirezmq/plugins   # every *.so file is loaded
+ * Their bridge types are then used like built-in ones, a plugin type replaces a built-in
+ * bridge with the same name. Plugins stay loaded until the server exits.
+ */
+namespace BridgePlugins
+{
+// returns true once the plugin bridge type is registered
+bool load(const std::filesystem::path& path);
+
+// returns the number of plugins loaded from directory
+std::size_t load_directory(const std::filesystem::path& directory);
+
+// loads the plugins of the "plugins" configuration section
+std::size_t setup(Config cfg);
+}
@@ -0,0 +1,344 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "CaptureFormat.hpp"
+#include "PacketQueue.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+namespace capture
+{
+namespace details
+{
+    // read only mapping of a whole file
+    class mapped_file
+    {
+        void* m_data = nullptr;
+        std::size_t m_size = 0;
+
+    public:
+        mapped_file() = default;
+        explicit mapped_file(const std::filesystem::path& path)
+        {
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                auto data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ,
+                    MAP_SHARED, fd, 0);
+                if (data != MAP_FAILED)
+                {
+                    m_data = data;
+                    m_size = static_cast<std::size_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+        }
+        mapped_file(const mapped_file&) = delete;
+        mapped_file& operator=(const mapped_file&) = delete;
+        mapped_file(mapped_file&& other) noexcept
+                : m_data { std::exchange(other.m_data, nullptr) }
+                , m_size { std::exchange(other.m_size, 0) }
+        {
+        }
+        mapped_file& operator=(mapped_file&& other) noexcept
+        {
+            std::swap(m_data, other.m_data);
+            std::swap(m_size, other.m_size);
+            return *this;
+        }
+        ~mapped_file()
+        {
+            if (m_data)
+                ::munmap(m_data, m_size);
+        }
+
+        inline const unsigned char* data() const
+        {
+            return static_cast<const unsigned char*>(m_data);
+        }
+        inline std::size_t size() const { return m_size; }
+        inline bool is_open() const { return m_data != nullptr; }
+        inline void advise(int advice) const
+        {
+            if (m_data)
+                ::madvise(m_data, m_size, advice);
+        }
+    };
+}
+
+// a recorded packet, pointing into the mapped segment
+struct packet_view
+{
+    uint64_t sequence;
+    const index_entry* entry;
+    std::string_view bridge_id;
+    const unsigned char* data;
+
+    inline std::size_t size() const { return entry->data_size; }
+    inline uint64_t timestamp_ns() const { return entry->timestamp_ns; }
+    inline spw_packet to_packet() const
+    {
+        return spw_packet { std::vector<unsigned char>(data, data + size()), entry->port,
+            std::string { bridge_id } };
+    }
+};
+}
+
+/*
+ * One capture segment and its index, both mapped. Opening only reads the headers so it takes
+ * the same time whatever the segment size. Without a valid index file the index is rebuilt
+ * in memory by walking the records.
+ */
+class CaptureSegment
+{
+    std::filesystem::path m_path;
+    capture::details::mapped_file m_data;
+    capture::details::mapped_file m_index;
+    std::vector<capture::index_entry> m_rebuilt_index;
+    capture::file_header m_header {};
+    const capture::index_entry* m_entries = nullptr;
+    std::size_t m_count = 0;
+
+    inline capture::record_header record(const capture::index_entry& entry) const
+    {
+        capture::record_header header;
+        std::memcpy(&header, m_data.data() + entry.offset, sizeof(header));
+        return header;
+    }
+
+    bool load_index()
+    {
+        m_index = capture::details::mapped_file { capture::index_path(m_path) };
+        capture::index_header header;
+        if (std::size(m_index) < sizeof(header))
+            return false;
+        std::memcpy(&header, m_index.data(), sizeof(header));
+        if (std::memcmp(header.magic, capture::index_magic, sizeof(header.magic)) != 0
+            || header.version != capture::version
+            || header.first_sequence != m_header.first_sequence
+            || header.header_size > std::size(m_index))
+            return false;
+        m_entries = reinterpret_cast<const capture::index_entry*>(
+            m_index.data() + header.header_size);
+        m_count = (std::size(m_index) - header.header_size) / sizeof(capture::index_entry);
+        // entries of records cut by a crash
+        while (m_count
+            && m_entries[m_count - 1].offset + sizeof(capture::record_header)
+                > std::size(m_data))
+            m_count--;
+        while (m_count
+            && m_entries[m_count - 1].offset + record(m_entries[m_count - 1]).record_size
+                > std::size(m_data))
+            m_count--;
+        return true;
+    }
+
+    void rebuild_index()
+    {
+        std::size_t offset = m_header.header_size;
+        while (offset + sizeof(capture::record_header) <= std::size(m_data))
+        {
+            capture::record_header header;
+            std::memcpy(&header, m_data.data() + offset, sizeof(header));
+            if (header.record_size == 0)
+            {
+                offset = capture::align_up(offset + 1, capture::block_size);
+                continue;
+            }
+            if (offset + header.record_size > std::size(m_data))
+                break;
+            const auto data = m_data.data() + offset + sizeof(header) + header.bridge_id_size;
+            m_rebuilt_index.push_back({ offset, header.timestamp_ns, header.data_size,
+                header.port,
+                capture::bridge_hash({ reinterpret_cast<const char*>(
+                                           m_data.data() + offset + sizeof(header)),
+                    header.bridge_id_size }),
+                capture::apid(data, header.data_size), header.protocol, 0 });
+            offset += header.record_size;
+        }
+        m_entries = m_rebuilt_index.data();
+        m_count = std::size(m_rebuilt_index);
+    }
+
+public:
+    explicit CaptureSegment(const std::filesystem::path& path)
+            : m_path { path }, m_data { path }
+    {
+        if (std::size(m_data) < sizeof(m_header))
+            return;
+        std::memcpy(&m_header, m_data.data(), sizeof(m_header));
+        if (std::memcmp(m_header.magic, capture::magic, sizeof(m_header.magic)) != 0)
+        {
+            m_header = {};
+            return;
+        }
+        if (!load_index())
+            rebuild_index();
+    }
+
+    CaptureSegment(CaptureSegment&&) = default;
+    CaptureSegment& operator=(CaptureSegment&&) = default;
+
+    inline bool is_valid() const { return m_header.version == capture::version; }
+    inline const std::filesystem::path& path() const { return m_path; }
+    inline std::size_t size() const { return m_count; }
+    inline uint64_t first_sequence() const { return m_header.first_sequence; }
+    inline uint64_t created_ns() const { return m_header.created_ns; }
+
+    inline const capture::index_entry* begin() const { return m_entries; }
+    inline const capture::index_entry* end() const { return m_entries + m_count; }
+
+    inline capture::packet_view operator[](std::size_t index) const
+    {
+        const auto& entry = m_entries[index];
+        const auto header = record(entry);
+        const auto bridge_id = reinterpret_cast<const char*>(
+            m_data.data() + entry.offset + sizeof(capture::record_header));
+        return { first_sequence() + index, &entry, { bridge_id, header.bridge_id_size },
+            m_data.data() + entry.offset + sizeof(capture::record_header)
+                + header.bridge_id_size };
+    }
+
+    // index of the first packet recorded at or after timestamp_ns
+    inline std::size_t lower_bound(uint64_t timestamp_ns) const
+    {
+        return static_cast<std::size_t>(
+            std::lower_bound(begin(), end(), timestamp_ns,
+                [](const capture::index_entry& entry, uint64_t timestamp) {
+                    return entry.timestamp_ns < timestamp;
+                })
+            - begin());
+    }
+
+    // e.g. MADV_SEQUENTIAL before reading the whole segment
+    inline void advise(int advice) const { m_data.advise(advice); }
+};
+
+/*
+ * All the segments of a capture, from a directory or a single segment file:
+ *   CaptureFile capture { "/data/captures" };
+ *   for (auto position = capture.seek(start_ns); auto packet = capture.read(position);)
+ *       if (packet->entry->apid == 0x1AB) ...
+ * Packets are ordered by sequence number, timestamps are assumed to grow with it.
+ */
+class CaptureFile
+{
+    std::vector<CaptureSegment> m_segments;
+
+public:
+    struct position
+    {
+        std::size_t segment = 0;
+        std::size_t index = 0;
+    };
+
+    explicit CaptureFile(const std::filesystem::path& path)
+    {
+        std::vector<std::filesystem::path> files;
+        if (std::filesystem::is_directory(path))
+        {
+            for (const auto& entry : std::filesystem::directory_iterator { path })
+            {
+                if (entry.path().extension() == ".spwcap")
+                    files.push_back(entry.path());
+            }
+        }
+        else
+        {
+            files.push_back(path);
+        }
+        for (const auto& file : files)
+        {
+            if (CaptureSegment segment { file }; segment.is_valid())
+                m_segments.push_back(std::move(segment));
+        }
+        std::sort(std::begin(m_segments), std::end(m_segments),
+            [](const CaptureSegment& a, const CaptureSegment& b) {
+                // creation time first, it orders segments of several recorder runs
+                return std::make_pair(a.created_ns(), a.first_sequence())
+                    < std::make_pair(b.created_ns(), b.first_sequence());
+            });
+    }
+
+    inline const std::vector<CaptureSegment>& segments() const { return m_segments; }
+
+    inline std::size_t size() const
+    {
+        std::size_t count = 0;
+        for (const auto& segment : m_segments)
+            count += std::size(segment);
+        return count;
+    }
+
+    inline position begin() const { return {}; }
+
+    // first packet recorded at or after timestamp_ns
+    inline position seek(uint64_t timestamp_ns) const
+    {
+        for (auto segment = 0UL; segment < std::size(m_segments); segment++)
+        {
+            const auto index = m_segments[segment].lower_bound(timestamp_ns);
+            if (index < std::size(m_segments[segment]))
+                return { segment, index };
+        }
+        return { std::size(m_segments), 0 };
+    }
+
+    // packet with the given sequence number or the next recorded one
+    inline position seek_sequence(uint64_t sequence) const
+    {
+        for (auto segment = 0UL; segment < std::size(m_segments); segment++)
+        {
+            const auto& s = m_segments[segment];
+            if (sequence < s.first_sequence() + std::size(s))
+                return { segment,
+                    static_cast<std::size_t>(std::max(sequence, s.first_sequence())
+                        - s.first_sequence()) };
+        }
+        return { std::size(m_segments), 0 };
+    }
+
+    // returns the packet at position and moves it to the next one, std::nullopt at the end
+    inline std::optional<capture::packet_view> read(position& pos) const
+    {
+        while (pos.segment < std::size(m_segments)
+            && pos.index >= std::size(m_segments[pos.segment]))
+            pos = { pos.segment + 1, 0 };
+        if (pos.segment >= std::size(m_segments))
+            return std::nullopt;
+        return m_segments[pos.segment][pos.index++];
+    }
+};
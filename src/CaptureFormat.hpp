@@ -0,0 +1,187 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "PacketQueue.hpp"
+#include "SpaceWireZMQ.hpp"
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+
+/*
+ * Capture segments written by the Recorder:
+ *  - a file_header padded to block_size, so records start on a block boundary
+ *  - records, each one is a record_header followed by the bridge ID, the packet bytes and zero
+ *    padding up to record_alignment
+ * Recorder buffers written with O_DIRECT must be whole blocks, when a partially filled buffer is
+ * flushed the rest of its last block is zeroed. A record_size of 0 means readers must skip to
+ * the next block boundary. All fields are little endian.
+ *
+ * Each segment comes with an index file (<segment>.idx), an index_header followed by one
+ * fixed size index_entry per record, in record order. Readers map it and binary search it
+ * instead of parsing the segment, the Nth entry is the packet with sequence number
+ * first_sequence + N. Index entries are written after their records so a segment never has
+ * more index entries than records, when the index is missing it can be rebuilt from the
+ * segment. A recorder that fails to append to an index removes it for the same reason.
+ */
+namespace capture
+{
+static constexpr char magic[8] = { 'S', 'P', 'W', 'C', 'A', 'P', 0, 1 };
+// 2: segment and index headers carry the first sequence number
+static constexpr uint32_t version = 2;
+static constexpr std::size_t block_size = 4096;
+static constexpr std::size_t record_alignment = 8;
+static constexpr std::size_t max_bridge_id_size = 255;
+static constexpr char index_magic[8] = { 'S', 'P', 'W', 'I', 'D', 'X', 0, 1 };
+static constexpr uint16_t no_apid = 0xFFFF;
+
+struct file_header
+{
+    char magic[8];
+    uint32_t version;
+    // records start at this offset
+    uint32_t header_size;
+    // nanoseconds since epoch
+    uint64_t created_ns;
+    uint64_t segment_index;
+    // sequence number of the first record, a recorder continues the sequence of the last
+    // segment it finds in its directory
+    uint64_t first_sequence;
+};
+
+struct record_header
+{
+    // whole record size, header and padding included
+    uint32_t record_size;
+    uint32_t data_size;
+    // reception time in nanoseconds since epoch
+    uint64_t timestamp_ns;
+    uint32_t port;
+    // SpaceWire protocol ID, 0 for packets too short to carry one
+    uint8_t protocol;
+    uint8_t bridge_id_size;
+    uint16_t reserved;
+};
+
+struct index_header
+{
+    char magic[8];
+    uint32_t version;
+    // entries start at this offset
+    uint32_t header_size;
+    uint64_t first_sequence;
+    uint64_t segment_index;
+};
+
+struct index_entry
+{
+    // record offset in the segment
+    uint64_t offset;
+    uint64_t timestamp_ns;
+    uint32_t data_size;
+    uint32_t port;
+    // see bridge_hash
+    uint32_t bridge_hash;
+    // no_apid unless the packet is CCSDS
+    uint16_t apid;
+    uint8_t protocol;
+    uint8_t reserved;
+};
+
+static_assert(sizeof(file_header) <= block_size);
+static_assert(sizeof(record_header) == 24 && sizeof(record_header) % record_alignment == 0);
+static_assert(sizeof(index_entry) == 32);
+
+// 32 bits FNV-1a, lets index entries be filtered by bridge without a string table
+inline constexpr uint32_t bridge_hash(std::string_view bridge_id)
+{
+    uint32_t hash = 2166136261u;
+    for (const auto c : bridge_id.substr(0, max_bridge_id_size))
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+inline std::filesystem::path index_path(const std::filesystem::path& segment)
+{
+    auto path = segment;
+    path += ".idx";
+    return path;
+}
+
+inline uint8_t protocol(const unsigned char* data, std::size_t size)
+{
+    return size >= 2 ? data[1] : 0;
+}
+
+inline uint16_t apid(const unsigned char* data, std::size_t size)
+{
+    if (protocol(data, size) == static_cast<uint8_t>(spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS)
+        && topics::ccsds::has_primary_header(size))
+        return topics::ccsds::apid(data);
+    return no_apid;
+}
+
+inline constexpr std::size_t align_up(std::size_t size, std::size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+inline std::size_t record_size(const spw_packet& packet)
+{
+    return align_up(sizeof(record_header)
+            + std::min(std::size(packet.bridge_id), max_bridge_id_size) + packet.size(),
+        record_alignment);
+}
+
+// out must hold at least record_size(packet) bytes, returns the record size
+inline std::size_t write_record(
+    unsigned char* out, const spw_packet& packet, uint64_t timestamp_ns)
+{
+    const auto size = record_size(packet);
+    const auto bridge_id_size = std::min(std::size(packet.bridge_id), max_bridge_id_size);
+    const record_header header { static_cast<uint32_t>(size),
+        static_cast<uint32_t>(packet.size()), timestamp_ns, static_cast<uint32_t>(packet.port),
+        protocol(packet.data.data(), packet.size()), static_cast<uint8_t>(bridge_id_size), 0 };
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+    std::memcpy(out, packet.bridge_id.data(), bridge_id_size);
+    out += bridge_id_size;
+    std::memcpy(out, packet.data.data(), packet.size());
+    out += packet.size();
+    std::fill(out, out + (size - sizeof(header) - bridge_id_size - packet.size()), 0);
+    return size;
+}
+
+// offset is the record offset, relative to the start of the recorder buffer until written
+inline index_entry make_index_entry(
+    const spw_packet& packet, uint64_t offset, uint64_t timestamp_ns)
+{
+    return { offset, timestamp_ns, static_cast<uint32_t>(packet.size()),
+        static_cast<uint32_t>(packet.port), bridge_hash(packet.bridge_id),
+        apid(packet.data.data(), packet.size()), protocol(packet.data.data(), packet.size()), 0 };
+}
+}
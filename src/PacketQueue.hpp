@@ -20,14 +20,103 @@
 --                     Mail : alexis.jeandet@lpp.polytechnique.fr
 ----------------------------------------------------------------------------*/
 #pragma once
+#include <algorithm>
 #include <channels/channels.hpp>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 #include <zmq.hpp>
 
+/*
+ * Packet bytes either owned by the buffer or adopted from a driver, adopted memory is released
+ * with the driver deleter once the packet is gone so received packets can reach the ZMQ socket
+ * without being copied. Copies and resizes always end up in owned memory.
+ */
+class packet_buffer
+{
+public:
+    using deleter_t = void (*)(unsigned char*);
+
+private:
+    std::vector<unsigned char> m_owned;
+    std::unique_ptr<unsigned char, deleter_t> m_adopted { nullptr, nullptr };
+    std::size_t m_adopted_size = 0;
+
+public:
+    packet_buffer() = default;
+    packet_buffer(std::size_t size) : m_owned(size) { }
+    packet_buffer(const std::vector<unsigned char>& data) : m_owned(data) { }
+    packet_buffer(std::vector<unsigned char>&& data) : m_owned(std::move(data)) { }
+    packet_buffer(const packet_buffer& other) : m_owned(other.begin(), other.end()) { }
+    packet_buffer(packet_buffer&& other) = default;
+    packet_buffer& operator=(const packet_buffer& other)
+    {
+        if (this != &other)
+            *this = packet_buffer { other };
+        return *this;
+    }
+    packet_buffer& operator=(packet_buffer&& other) = default;
+
+    // takes ownership of data, deleter is called with it once the buffer no longer needs it
+    static packet_buffer adopt(unsigned char* data, std::size_t size, deleter_t deleter)
+    {
+        packet_buffer buffer;
+        buffer.m_adopted = std::unique_ptr<unsigned char, deleter_t> { data, deleter };
+        buffer.m_adopted_size = size;
+        return buffer;
+    }
+
+    inline bool adopted() const { return bool(m_adopted); }
+
+    inline unsigned char* data() { return m_adopted ? m_adopted.get() : m_owned.data(); }
+    inline const unsigned char* data() const
+    {
+        return m_adopted ? m_adopted.get() : m_owned.data();
+    }
+    inline std::size_t size() const { return m_adopted ? m_adopted_size : std::size(m_owned); }
+    inline bool empty() const { return size() == 0; }
+
+    inline unsigned char* begin() { return data(); }
+    inline unsigned char* end() { return data() + size(); }
+    inline const unsigned char* begin() const { return data(); }
+    inline const unsigned char* end() const { return data() + size(); }
+
+    inline unsigned char& operator[](std::size_t index) { return data()[index]; }
+    inline const unsigned char& operator[](std::size_t index) const { return data()[index]; }
+
+    void resize(std::size_t size)
+    {
+        if (m_adopted)
+        {
+            m_owned.assign(begin(), end());
+            m_adopted.reset();
+            m_adopted_size = 0;
+        }
+        m_owned.resize(size);
+    }
+
+    bool operator==(const packet_buffer& other) const
+    {
+        return std::equal(begin(), end(), other.begin(), other.end());
+    }
+    bool operator!=(const packet_buffer& other) const { return !(*this == other); }
+};
+
 struct spw_packet
 {
-    std::vector<unsigned char> data;
+    packet_buffer data;
     std::size_t port;
     std::string bridge_id;
+    /*
+     * Stamped by SpaceWireBridge on reception, counts packets per bridge and per protocol ID
+     * so subscribers can detect lost packets, 0 for packets too short to carry a protocol ID.
+     * Not compared by operator==.
+     * Unlike the per topic sequence the server puts in the topic frame when publishing (used
+     * to resume from its history), it is given before the server so it also reveals packets
+     * the server itself dropped or never published.
+     */
+    uint64_t sequence = 0;
     spw_packet(std::size_t size, std::size_t port,const std::string& bridge_id)
             : data(size), port { port }, bridge_id { bridge_id }
     {
@@ -55,3 +144,48 @@ struct spw_packet
 };
 
 using packet_queue = channels::channel<spw_packet, 128, channels::full_policy::wait_for_space>;
+
+/*
+ * Link level events reported by bridges next to packets, time-codes are forwarded as soon as
+ * the bridge gets them, link status and error counters when they change.
+ */
+struct spw_event
+{
+    enum class kind_t : uint8_t
+    {
+        time_code,
+        link_up,
+        link_down,
+        errors
+    };
+    struct error_counters
+    {
+        uint32_t parity = 0;
+        uint32_t disconnect = 0;
+        uint32_t credit = 0;
+        uint32_t escape = 0;
+        bool operator==(const error_counters& other) const
+        {
+            return parity == other.parity && disconnect == other.disconnect
+                && credit == other.credit && escape == other.escape;
+        }
+        bool operator!=(const error_counters& other) const { return !(*this == other); }
+    };
+    kind_t kind = kind_t::time_code;
+    std::size_t port = 0;
+    std::string bridge_id;
+    // as received, 6 bits time value and 2 control flag bits
+    uint8_t time_code = 0;
+    // cumulative counts since the bridge started
+    error_counters errors;
+    // host reception time, nanoseconds since the Unix epoch
+    uint64_t timestamp_ns = 0;
+};
+
+constexpr std::size_t event_queue_capacity = 1024;
+/*
+ * Bridges push events from their driver threads (STAR-API callbacks for time-codes), adding
+ * must never wait there, see ISpaceWireBridge::publish_event.
+ */
+using event_queue = channels::channel<spw_event, event_queue_capacity,
+    channels::full_policy::overwrite_last>;
@@ -0,0 +1,348 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#include "Recorder.hpp"
+#include "CaptureFile.hpp"
+#include "CaptureFormat.hpp"
+#include "spdlog/spdlog.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace
+{
+uint64_t now_ns()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch())
+                                     .count());
+}
+
+std::string segment_name(const std::string& prefix, uint64_t created_ns, uint64_t index)
+{
+    const std::time_t created = static_cast<std::time_t>(created_ns / 1000000000UL);
+    std::tm utc {};
+    gmtime_r(&created, &utc);
+    char date[32];
+    std::strftime(date, sizeof(date), "%Y%m%dT%H%M%SZ", &utc);
+    return fmt::format("{}-{}-{:05}.spwcap", prefix, date, index);
+}
+
+unsigned char* aligned_alloc_blocks(std::size_t size)
+{
+    return static_cast<unsigned char*>(std::aligned_alloc(capture::block_size, size));
+}
+}
+
+Recorder::Recorder(Config cfg)
+        : m_directory { cfg["directory"].to<std::string>(".") }
+        , m_prefix { cfg["prefix"].to<std::string>("spacewire") }
+        , m_segment_size { static_cast<uint64_t>(std::max(cfg["segment_mb"].to<int>(1024), 1))
+              << 20 }
+        , m_segment_duration { cfg["segment_seconds"].to<int>(3600) }
+        , m_flush_interval { std::max(cfg["flush_ms"].to<int>(1000), 1) }
+        , m_buffer_size { capture::align_up(
+              static_cast<std::size_t>(std::max(cfg["buffer_mb"].to<int>(4), 1)) << 20,
+              capture::block_size) }
+        , m_direct_io { cfg["direct_io"].to<bool>(true) }
+{
+    std::error_code ec;
+    std::filesystem::create_directories(m_directory, ec);
+    if (ec)
+        spdlog::error("Can't create capture directory {}: {}", m_directory.string(), ec.message());
+    resume_sequence();
+    for (auto& buffer : m_buffers)
+        buffer.data.reset(aligned_alloc_blocks(m_buffer_size));
+    if (!m_buffers[0].data || !m_buffers[1].data)
+    {
+        // record() drops every packet once m_running is false
+        spdlog::error("Can't allocate {} bytes recorder buffers, recording is disabled",
+            m_buffer_size);
+        m_running = false;
+        return;
+    }
+    m_writer = std::thread(&Recorder::writer_thread, this);
+}
+
+Recorder::~Recorder()
+{
+    close();
+}
+
+bool Recorder::record(const spw_packet& packet)
+{
+    const auto size = capture::record_size(packet);
+    const auto timestamp = now_ns();
+    std::lock_guard<std::mutex> lock { m_mutex };
+    if (!m_running || size > m_buffer_size)
+    {
+        m_dropped++;
+        return false;
+    }
+    if (m_buffers[m_active].used + size > m_buffer_size)
+    {
+        // the writer is still busy with the other buffer
+        if (m_full)
+        {
+            m_dropped++;
+            return false;
+        }
+        m_full = m_active;
+        m_active ^= 1;
+        m_cv.notify_one();
+    }
+    auto& buffer = m_buffers[m_active];
+    buffer.index.push_back(capture::make_index_entry(packet, buffer.used, timestamp));
+    buffer.used += capture::write_record(buffer.data.get() + buffer.used, packet, timestamp);
+    return true;
+}
+
+void Recorder::close()
+{
+    {
+        std::lock_guard<std::mutex> lock { m_mutex };
+        m_running = false;
+    }
+    m_cv.notify_one();
+    if (m_writer.joinable())
+        m_writer.join();
+}
+
+void Recorder::writer_thread()
+{
+    std::unique_lock<std::mutex> lock { m_mutex };
+    while (true)
+    {
+        m_cv.wait_for(lock, m_flush_interval, [this]() { return m_full || !m_running; });
+        // nothing filled a buffer for a while or the recorder is closing, flush what we have
+        if (!m_full && m_buffers[m_active].used)
+        {
+            m_full = m_active;
+            m_active ^= 1;
+        }
+        if (m_full)
+        {
+            auto& buffer = m_buffers[*m_full];
+            lock.unlock();
+            write_buffer(buffer);
+            lock.lock();
+            buffer.used = 0;
+            buffer.index.clear();
+            m_full.reset();
+        }
+        else if (!m_running)
+        {
+            break;
+        }
+    }
+    lock.unlock();
+    close_segment();
+}
+
+void Recorder::write_buffer(aligned_buffer& buffer)
+{
+    if (m_fd >= 0
+        && (m_offset >= m_segment_size
+            || (m_segment_duration.count()
+                && std::chrono::steady_clock::now() - m_segment_start >= m_segment_duration)))
+        close_segment();
+    if (m_fd < 0 && !open_segment())
+    {
+        m_dropped += std::size(buffer.index);
+        return;
+    }
+    auto size = buffer.used;
+    if (m_segment_direct)
+    {
+        // O_DIRECT writes whole blocks, readers skip the zeroed tail
+        size = capture::align_up(size, capture::block_size);
+        std::fill(buffer.data.get() + buffer.used, buffer.data.get() + size, 0);
+    }
+    if (!write_all(m_fd, buffer.data.get(), size))
+    {
+        m_dropped += std::size(buffer.index);
+        close_segment();
+        return;
+    }
+    for (auto& entry : buffer.index)
+        entry.offset += m_offset;
+    if (m_index_fd >= 0
+        && !write_all(m_index_fd, reinterpret_cast<const unsigned char*>(buffer.index.data()),
+            std::size(buffer.index) * sizeof(capture::index_entry)))
+        remove_index();
+    m_data_end = m_offset + buffer.used;
+    m_offset += size;
+    m_sequence += std::size(buffer.index);
+    m_recorded += std::size(buffer.index);
+    m_bytes_written += buffer.used;
+}
+
+bool Recorder::open_segment()
+{
+    const auto created = now_ns();
+    const auto path = m_directory / segment_name(m_prefix, created, m_segment_index);
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    m_fd = m_direct_io ? ::open(path.c_str(), flags | O_DIRECT, 0644) : -1;
+    m_segment_direct = m_fd >= 0;
+    if (m_fd < 0)
+    {
+        if (m_direct_io)
+            spdlog::warn("O_DIRECT isn't supported for {}, using buffered writes", path.string());
+        m_fd = ::open(path.c_str(), flags, 0644);
+    }
+    if (m_fd < 0)
+    {
+        spdlog::error("Can't open capture file {}: {}", path.string(), std::strerror(errno));
+        return false;
+    }
+
+    std::unique_ptr<unsigned char, decltype(&std::free)> block {
+        aligned_alloc_blocks(capture::block_size), &std::free
+    };
+    if (!block)
+    {
+        spdlog::error("Can't allocate the header of capture file {}", path.string());
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+    std::fill(block.get(), block.get() + capture::block_size, 0);
+    capture::file_header header {};
+    std::memcpy(header.magic, capture::magic, sizeof(header.magic));
+    header.version = capture::version;
+    header.header_size = capture::block_size;
+    header.created_ns = created;
+    header.segment_index = m_segment_index;
+    header.first_sequence = m_sequence;
+    std::memcpy(block.get(), &header, sizeof(header));
+    m_offset = 0;
+    if (!write_all(m_fd, block.get(), capture::block_size))
+    {
+        ::close(m_fd);
+        m_fd = -1;
+        return false;
+    }
+
+    capture::index_header index_header {};
+    std::memcpy(index_header.magic, capture::index_magic, sizeof(index_header.magic));
+    index_header.version = capture::version;
+    index_header.header_size = sizeof(index_header);
+    index_header.first_sequence = m_sequence;
+    index_header.segment_index = m_segment_index;
+    m_index_path = capture::index_path(path);
+    m_index_fd = ::open(m_index_path.c_str(), flags, 0644);
+    if (m_index_fd < 0
+        || !write_all(m_index_fd, reinterpret_cast<const unsigned char*>(&index_header),
+            sizeof(index_header)))
+        remove_index();
+
+    m_offset = m_data_end = capture::block_size;
+    m_segment_start = std::chrono::steady_clock::now();
+    m_segment_index++;
+    m_segments++;
+    spdlog::info("Recording packets to {}", path.string());
+    return true;
+}
+
+void Recorder::close_segment()
+{
+    if (m_fd < 0)
+        return;
+    // drops the padding of the last O_DIRECT write
+    if (m_data_end != m_offset && ::ftruncate(m_fd, static_cast<off_t>(m_data_end)) != 0)
+        spdlog::error("Can't truncate capture file: {}", std::strerror(errno));
+    ::close(m_fd);
+    m_fd = -1;
+    if (m_index_fd >= 0)
+        ::close(m_index_fd);
+    m_index_fd = -1;
+}
+
+/*
+ * Entries appended after a failed write would no longer match first_sequence + N, so the index
+ * is removed and readers rebuild it from the segment.
+ */
+void Recorder::remove_index()
+{
+    spdlog::error("Can't write capture index {}, removing it: {}", m_index_path.string(),
+        std::strerror(errno));
+    if (m_index_fd >= 0)
+        ::close(m_index_fd);
+    m_index_fd = -1;
+    std::error_code ec;
+    std::filesystem::remove(m_index_path, ec);
+}
+
+// sequence numbers go on from the last segment so segments of several runs never overlap
+void Recorder::resume_sequence()
+{
+    std::error_code ec;
+    std::filesystem::path last;
+    capture::file_header last_header {};
+    for (const auto& entry : std::filesystem::directory_iterator { m_directory, ec })
+    {
+        const auto& path = entry.path();
+        if (path.extension() != ".spwcap" || path.filename().string().rfind(m_prefix + "-", 0) != 0)
+            continue;
+        // only headers are read, the last segment alone is indexed below
+        capture::file_header header {};
+        std::ifstream file { path, std::ios::binary };
+        if (!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || std::memcmp(header.magic, capture::magic, sizeof(header.magic)) != 0
+            || header.version != capture::version)
+            continue;
+        if (std::empty(last) || header.created_ns > last_header.created_ns)
+        {
+            last = path;
+            last_header = header;
+        }
+    }
+    if (std::empty(last))
+        return;
+    const CaptureSegment segment { last };
+    m_sequence = segment.first_sequence() + std::size(segment);
+    m_segment_index = last_header.segment_index + 1;
+    spdlog::info("Capture continues {} from sequence {}", last.string(), m_sequence);
+}
+
+bool Recorder::write_all(int fd, const unsigned char* data, std::size_t size)
+{
+    if (fd < 0)
+        return false;
+    while (size)
+    {
+        const auto written = ::write(fd, data, size);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            spdlog::error("Capture write failed: {}", std::strerror(errno));
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
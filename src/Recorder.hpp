@@ -0,0 +1,137 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "CaptureFormat.hpp"
+#include "PacketQueue.hpp"
+#include "config/Config.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct recorder_statistics
+{
+    // written to disk
+    uint64_t recorded = 0;
+    // dropped since both buffers were full (the disk doesn't keep up) or a write failed
+    uint64_t dropped = 0;
+    uint64_t bytes_written = 0;
+    uint64_t segments = 0;
+};
+
+/*
+ * Appends every packet given to record() to segmented capture files and their index (see
+ * CaptureFormat.hpp, CaptureFile.hpp reads them):
+ *   recorder:
+ *     directory: /data/captures
+ *     prefix: spacewire        # <prefix>-<UTC start time>-<segment index>.spwcap
+ *     segment_mb: 1024         # a new segment is opened once this size is reached
+ *     segment_seconds: 3600    # or once this age is reached, 0 disables it
+ *     buffer_mb: 4
+ *     flush_ms: 1000           # partially filled buffers are written after this delay
+ *     direct_io: true          # O_DIRECT, falls back to buffered writes if unsupported
+ * Packets are copied into one of two block aligned buffers while a writer thread writes the
+ * other one with large sequential writes. record() never waits for the disk, when both
+ * buffers are full packets are dropped and counted.
+ */
+class Recorder
+{
+    struct aligned_buffer
+    {
+        std::unique_ptr<unsigned char, decltype(&std::free)> data { nullptr, &std::free };
+        std::size_t used = 0;
+        // offsets are relative to the buffer start until written
+        std::vector<capture::index_entry> index;
+    };
+
+    std::filesystem::path m_directory;
+    std::string m_prefix;
+    uint64_t m_segment_size;
+    std::chrono::seconds m_segment_duration;
+    std::chrono::milliseconds m_flush_interval;
+    std::size_t m_buffer_size;
+    bool m_direct_io;
+
+    std::array<aligned_buffer, 2> m_buffers;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::size_t m_active = 0;
+    // buffer handed over to the writer thread
+    std::optional<std::size_t> m_full;
+    bool m_running = true;
+    std::thread m_writer;
+
+    int m_fd = -1;
+    int m_index_fd = -1;
+    std::filesystem::path m_index_path;
+    uint64_t m_segment_index = 0;
+    // sequence number of the next written record
+    uint64_t m_sequence = 0;
+    uint64_t m_offset = 0;
+    // end of the last record, differs from m_offset when O_DIRECT writes were padded
+    uint64_t m_data_end = 0;
+    std::chrono::steady_clock::time_point m_segment_start;
+    bool m_segment_direct = false;
+
+    std::atomic<uint64_t> m_recorded { 0 };
+    std::atomic<uint64_t> m_dropped { 0 };
+    std::atomic<uint64_t> m_bytes_written { 0 };
+    std::atomic<uint64_t> m_segments { 0 };
+
+    void writer_thread();
+    void write_buffer(aligned_buffer& buffer);
+    bool open_segment();
+    void close_segment();
+    void remove_index();
+    void resume_sequence();
+    bool write_all(int fd, const unsigned char* data, std::size_t size);
+
+public:
+    explicit Recorder(Config cfg);
+    ~Recorder();
+
+    // called from the publisher thread, returns false if the packet was dropped
+    bool record(const spw_packet& packet);
+
+    // flushes buffered packets and closes the current segment
+    void close();
+
+    inline recorder_statistics statistics() const
+    {
+        return { m_recorded.load(), m_dropped.load(), m_bytes_written.load(),
+            m_segments.load() };
+    }
+
+    inline static bool enabled(Config cfg)
+    {
+        return !std::empty(cfg["directory"].to<std::string>(""));
+    }
+};
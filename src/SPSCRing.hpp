@@ -0,0 +1,85 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+
+/*
+ * Fixed capacity single producer / single consumer ring, push and pop never allocate nor lock.
+ * Only one thread may push and only one thread may pop, a push on a full ring drops the value
+ * and counts it as an overflow.
+ */
+template <typename T, std::size_t capacity_>
+class SPSCRing
+{
+    static_assert(capacity_ >= 2 && (capacity_ & (capacity_ - 1)) == 0,
+        "SPSCRing capacity must be a power of two");
+    static constexpr std::size_t mask = capacity_ - 1;
+    static constexpr std::size_t cache_line = 64;
+
+    std::array<std::optional<T>, capacity_> m_slots;
+    alignas(cache_line) std::atomic<std::size_t> m_head { 0 }; // next slot to pop
+    alignas(cache_line) std::atomic<std::size_t> m_tail { 0 }; // next slot to push
+    alignas(cache_line) std::atomic<uint64_t> m_overflows { 0 };
+
+public:
+    static constexpr std::size_t capacity = capacity_;
+
+    inline bool push(T&& value)
+    {
+        const auto tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == capacity_)
+        {
+            m_overflows.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        m_slots[tail & mask].emplace(std::move(value));
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    inline std::optional<T> pop()
+    {
+        const auto head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return std::nullopt;
+        auto& slot = m_slots[head & mask];
+        std::optional<T> value { std::move(*slot) };
+        slot.reset();
+        m_head.store(head + 1, std::memory_order_release);
+        return value;
+    }
+
+    inline std::size_t size() const
+    {
+        const auto head = m_head.load(std::memory_order_acquire);
+        return m_tail.load(std::memory_order_acquire) - head;
+    }
+
+    inline bool empty() const { return size() == 0; }
+
+    inline uint64_t overflows() const { return m_overflows.load(std::memory_order_relaxed); }
+};
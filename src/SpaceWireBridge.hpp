@@ -23,16 +23,71 @@
 #include "PacketQueue.hpp"
 #include "config/Config.hpp"
 #include <spdlog/spdlog.h>
+#include <array>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <thread>
 #include <vector>
 using namespace std::chrono_literals;
 
 class ISpaceWireBridge
 {
+    std::atomic<event_queue*> m_events { nullptr };
+    std::atomic<uint64_t> m_dropped_events { 0 };
+    std::string m_name;
+
+protected:
+    /*
+     * Bridges producing link events (see spw_event) call this from whatever thread gets them,
+     * events are dropped until the server listens to them. It never waits: when the server
+     * event thread falls behind and the queue is full, the event is dropped and counted in
+     * dropped_events().
+     */
+    inline void publish_event(spw_event&& event)
+    {
+        if (auto events = m_events.load(); events && !events->closed())
+        {
+            if (std::size(*events) >= event_queue_capacity)
+            {
+                if (m_dropped_events++ == 0)
+                    spdlog::warn("{}: event queue full, dropping events", m_name);
+                return;
+            }
+            if (std::empty(event.bridge_id))
+                event.bridge_id = m_name;
+            if (!event.timestamp_ns)
+                event.timestamp_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::system_clock::now().time_since_epoch())
+                                         .count();
+            *events << std::move(event);
+        }
+    }
+
 public:
+    // name tags the published events
+    inline void set_event_queue(event_queue* events, const std::string& name)
+    {
+        m_name = name;
+        m_events = events;
+    }
+
+    inline uint64_t dropped_events() const { return m_dropped_events.load(); }
+
     virtual bool send_packet(const spw_packet& packet) = 0;
+    /*
+     * Packets already waiting in the sending queue are given at once, bridges able to send
+     * several packets per system call override it. Returns the number of packets sent.
+     */
+    virtual std::size_t send_packets(const std::vector<spw_packet>& packets)
+    {
+        std::size_t sent = 0;
+        for (const auto& packet : packets)
+            sent += send_packet(packet);
+        return sent;
+    }
     virtual spw_packet receive_packet() = 0;
 
     virtual bool packet_received() = 0;
@@ -48,12 +103,17 @@ class SpaceWireBridge
     std::unique_ptr<ISpaceWireBridge> m_bridge;
     packet_queue m_sending_queue;
     packet_queue* m_publish_queue = nullptr;
+    std::string m_name;
     std::thread m_rec_thread;
     std::thread m_send_thread;
+    static constexpr std::size_t max_send_batch = 64;
+    // last sequence number stamped for each protocol ID
+    std::array<uint64_t, 256> m_sequences {};
 
 public:
-    SpaceWireBridge(std::unique_ptr<ISpaceWireBridge>&& bridge, packet_queue* publish_queue)
-            : m_bridge { std::move(bridge) }, m_publish_queue { publish_queue }
+    SpaceWireBridge(std::unique_ptr<ISpaceWireBridge>&& bridge, packet_queue* publish_queue,
+        const std::string& name = {})
+            : m_bridge { std::move(bridge) }, m_publish_queue { publish_queue }, m_name { name }
     {
         m_rec_thread = std::thread(&SpaceWireBridge::receiving_thread, this);
         m_send_thread = std::thread(&SpaceWireBridge::sending_thread, this);
@@ -68,6 +128,11 @@ public:
 
     void send(spw_packet&& packet) { m_sending_queue.add(std::move(packet)); }
 
+    inline const std::string& name() const { return m_name; }
+
+    void set_event_queue(event_queue* events) { m_bridge->set_event_queue(events, m_name); }
+    inline uint64_t dropped_events() const { return m_bridge->dropped_events(); }
+
     bool set_configuration(const Config& cfg) { return m_bridge->set_configuration(cfg); }
     Config configuration() const { return m_bridge->configuration(); }
 
@@ -82,7 +147,15 @@ private:
                 if (m_bridge->packet_received())
                 {
                     spdlog::debug("Got one packet");
-                    *m_publish_queue << m_bridge->receive_packet();
+                    auto packet = m_bridge->receive_packet();
+                    // so replies from clients get routed back to this bridge instance
+                    if (std::empty(packet.bridge_id))
+                        packet.bridge_id = m_name;
+                    // packets too short to carry a protocol ID are never published, stamping
+                    // them would show as gaps in a real protocol sequence
+                    if (packet.size() >= 2)
+                        packet.sequence = ++m_sequences[packet.data[1]];
+                    *m_publish_queue << std::move(packet);
                     tries = 0;
                 }
                 else
@@ -96,11 +169,21 @@ private:
 
     void sending_thread()
     {
+        std::vector<spw_packet> batch;
         while (!m_sending_queue.closed())
         {
             auto maybe_packet = m_sending_queue.take();
-            if (maybe_packet)
-                m_bridge->send_packet(*maybe_packet);
+            if (!maybe_packet)
+                continue;
+            batch.clear();
+            batch.push_back(std::move(*maybe_packet));
+            // never waits for more packets, only takes the ones already queued
+            while (std::size(batch) < max_send_batch && std::size(m_sending_queue))
+            {
+                if (auto packet = m_sending_queue.take())
+                    batch.push_back(std::move(*packet));
+            }
+            m_bridge->send_packets(batch);
         }
     }
 };
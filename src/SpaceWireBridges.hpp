@@ -26,6 +26,7 @@
 #include <containers/algorithms.hpp>
 #include <cpp_utils.hpp>
 #include <functional>
+#include <optional>
 #include <spdlog/spdlog.h>
 #include <string>
 #include <unordered_map>
@@ -38,8 +39,9 @@ auto scope_leave_guard(T function)
     return std::shared_ptr<void>( nullptr , std::move( function ) );
 }
 
+// name is the bridge instance name, used as bridge_id of the packets it receives
 using SpaceWireBridge_ctor = std::function<std::unique_ptr<SpaceWireBridge>(
-    const Config& cfg, packet_queue* publish_queue)>;
+    const std::string& name, const Config& cfg, packet_queue* publish_queue)>;
 
 namespace details
 {
@@ -50,14 +52,46 @@ struct SpaceWireBrigesSingleton
         static SpaceWireBrigesSingleton self;
         return self;
     }
-    static void load_bridge(
-        const std::string& bridge_id, const Config& config, packet_queue* publish_queue)
+    /*
+     * Bridge instances are named after their type ("Mock", "STAR-Dundee"...), several instances
+     * of one type need distinct names either starting with the type ("STAR-Dundee-A") or
+     * giving it with a "type" key. Each instance gets its own receiving and sending threads
+     * and all of them publish to the same queue.
+     */
+    std::optional<std::string> bridge_type(const std::string& name, Config config) const
+    {
+        if (const auto type = config["type"].to<std::string>(""); !std::empty(type))
+        {
+            if (factory.count(type))
+                return type;
+            return std::nullopt;
+        }
+        std::optional<std::string> type;
+        for (const auto& [candidate, _] : factory)
+        {
+            if (name.compare(0, std::size(candidate), candidate) == 0
+                && std::size(candidate) > std::size(type.value_or("")))
+                type = candidate;
+        }
+        return type;
+    }
+
+    static void load_bridge(const std::string& bridge_id, const Config& config,
+        packet_queue* publish_queue, event_queue* events = nullptr)
     {
         using namespace cpp_utils::containers;
         auto& self = instance();
-        if (contains(self.factory, bridge_id) && !contains(self.loaded_bridges, bridge_id))
+        if (contains(self.loaded_bridges, bridge_id))
         {
-            auto bridge = self.factory[bridge_id](config, publish_queue);
+            spdlog::error("Bridge {} already loaded, not loading it twice.", bridge_id);
+        }
+        else if (const auto type = self.bridge_type(bridge_id, config))
+        {
+            if (*type != bridge_id)
+                spdlog::info("Loading bridge {} as {}", bridge_id, *type);
+            auto bridge = self.factory[*type](bridge_id, config, publish_queue);
+            if (events)
+                bridge->set_event_queue(events);
             self.loaded_bridges[bridge_id] = std::move(bridge);
         }
         else
@@ -90,8 +124,10 @@ struct SpaceWireBrigesSingleton
 class SpaceWireBridges
 {
 public:
+    // events is usually &ZMQServer::received_events, bridge events are dropped without it
     HEDLEY_WARN_UNUSED_RESULT
-    static inline auto setup(Config config, packet_queue* publish_queue)
+    static inline auto setup(
+        Config config, packet_queue* publish_queue, event_queue* events = nullptr)
     {
         using namespace cpp_utils::containers;
         if (!config.isEmpty())
@@ -99,7 +135,7 @@ public:
             for (const auto& [name, node] : config)
             {
                 details::SpaceWireBrigesSingleton::instance().load_bridge(
-                    name, *node.get(), publish_queue);
+                    name, *node.get(), publish_queue, events);
             }
         }
         return scope_leave_guard([](auto){SpaceWireBridges::teardown();});
@@ -114,6 +150,12 @@ public:
         return true;
     }
 
+    static bool has_ctor(const std::string& name)
+    {
+        using namespace details;
+        return SpaceWireBrigesSingleton::instance().factory.count(name) != 0;
+    }
+
     static inline void send(spw_packet&& packet)
     {
         using namespace details;
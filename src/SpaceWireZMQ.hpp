@@ -21,11 +21,27 @@
 ----------------------------------------------------------------------------*/
 #pragma once
 #include "PacketQueue.hpp"
+#include "config/Config.hpp"
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <spdlog/spdlog.h>
 #include <yas/object.hpp>
 #include <yas/serialize.hpp>
 #include <yas/std_types.hpp>
 #include <zmq.hpp>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 namespace topics
 {
@@ -36,7 +52,8 @@ enum class types
     EXTEND = 2,
     GOES_R = 3,
     STUP = 4,
-    UNKNOWN = 5
+    RAW = 5,
+    UNKNOWN = 6
 };
 
 namespace strings
@@ -46,35 +63,8 @@ namespace strings
     static constexpr char EXTEND[] = "/EXTEND/";
     static constexpr char GOES_R[] = "/GOES_R/";
     static constexpr char STUP[] = "/STUP/";
-    static constexpr std::array table = { RMAP, CCSDS, EXTEND, GOES_R, STUP };
-    inline types to_type(const std::string& topic)
-    {
-        switch (topic[1]) {
-        case 'R':
-            if(topic==RMAP)
-                return types::RMAP;
-            break;
-        case 'C':
-            if(topic==CCSDS)
-                return types::CCSDS;
-            break;
-        case 'E':
-            if(topic==EXTEND)
-                return types::EXTEND;
-            break;
-        case 'G':
-            if(topic==GOES_R)
-                return types::GOES_R;
-            break;
-        case 'S':
-            if(topic==STUP)
-                return types::STUP;
-            break;
-        default:
-            break;
-        }
-        return types::UNKNOWN;
-    }
+    static constexpr char RAW[] = "/RAW/";
+    static constexpr std::array table = { RMAP, CCSDS, EXTEND, GOES_R, STUP, RAW };
 }
 
 static constexpr std::size_t max_size = 16;
@@ -89,54 +79,590 @@ inline constexpr const char* to_string(types topic)
     return strings::table[topic_index];
 }
 
-inline std::size_t end_of_topic(const unsigned char* buffer)
+// topic name as used in configuration keys, "/CCSDS/" -> "CCSDS"
+inline std::string name(types topic)
+{
+    const std::string_view topic_string { to_string(topic) };
+    if (std::size(topic_string) < 2)
+        return {};
+    return std::string { topic_string.substr(1, std::size(topic_string) - 2) };
+}
+
+inline types from_name(std::string_view topic_name)
+{
+    for (auto index = 0UL; index < std::size(strings::table); index++)
+    {
+        if (name(static_cast<types>(index)) == topic_name)
+            return static_cast<types>(index);
+    }
+    return types::UNKNOWN;
+}
+
+namespace ccsds
+{
+    /*
+     * CCSDS packets are sent over SpaceWire with the CCSDS Packet Transfer Protocol, the
+     * CCSDS primary header follows the target logical address, protocol ID, reserved and user
+     * application bytes.
+     * CCSDS topics are published as "/CCSDS/<APID as 3 hex digits>/<TM|TC>/" so subscribers
+     * can filter on APID and packet type with plain ZMQ prefix matching.
+     */
+    static constexpr std::size_t primary_header_offset = 4;
+    static constexpr std::size_t primary_header_size = 6;
+    static constexpr uint16_t max_apid = 0x7FF;
+    static constexpr std::size_t apid_digits = 3;
+
+    enum class packet_type
+    {
+        TM = 0,
+        TC = 1
+    };
+
+    inline bool has_primary_header(std::size_t size)
+    {
+        return size >= (primary_header_offset + primary_header_size);
+    }
+
+    inline uint16_t apid(const unsigned char* packet)
+    {
+        const auto header = packet + primary_header_offset;
+        return static_cast<uint16_t>(((header[0] & 0x07) << 8) | header[1]);
+    }
+
+    inline packet_type type(const unsigned char* packet)
+    {
+        return static_cast<packet_type>((packet[primary_header_offset] >> 4) & 1);
+    }
+
+    inline std::string apid_prefix(uint16_t apid, std::size_t digits = apid_digits)
+    {
+        static constexpr char hex[] = "0123456789ABCDEF";
+        std::string prefix { strings::CCSDS };
+        for (auto digit = 0UL; digit < digits; digit++)
+        {
+            prefix += hex[(apid >> (4 * (apid_digits - 1 - digit))) & 0xF];
+        }
+        if (digits == apid_digits)
+            prefix += '/';
+        return prefix;
+    }
+
+    inline std::string to_topic(uint16_t apid, packet_type type)
+    {
+        return apid_prefix(apid) + (type == packet_type::TM ? "TM/" : "TC/");
+    }
+
+    inline std::string to_topic(const unsigned char* packet, std::size_t size)
+    {
+        if (has_primary_header(size))
+            return to_topic(apid(packet), type(packet));
+        return strings::CCSDS;
+    }
+
+    struct apid_range
+    {
+        uint16_t first;
+        uint16_t last;
+        std::optional<packet_type> type = std::nullopt;
+    };
+
+    // Builds the smallest set of subscription prefixes covering the given APID range, aligned
+    // blocks of 16 or 256 APIDs share a shorter prefix when no packet type filter is set.
+    inline std::vector<std::string> subscriptions(const apid_range& range)
+    {
+        std::vector<std::string> prefixes;
+        const uint32_t last = std::min(range.last, max_apid);
+        uint32_t apid = range.first;
+        while (apid <= last)
+        {
+            uint32_t block = 1;
+            std::size_t digits = apid_digits;
+            while (!range.type && digits > 1 && (apid % (block * 16) == 0)
+                && (apid + block * 16 - 1 <= last))
+            {
+                block *= 16;
+                digits--;
+            }
+            if (range.type)
+                prefixes.push_back(to_topic(static_cast<uint16_t>(apid), *range.type));
+            else
+                prefixes.push_back(apid_prefix(static_cast<uint16_t>(apid), digits));
+            apid += block;
+        }
+        return prefixes;
+    }
+}
+
+/*
+ * Protocol ID to topic dispatch table, each entry holds the precomputed topic bytes so the
+ * publish path only has to index it with the packet protocol ID.
+ * Packets with a protocol ID that doesn't match any known topic are published as
+ * "/RAW/<protocol ID as 2 hex digits>/", custom protocols can be given their own topic
+ * from the configuration (see load_protocol_table).
+ */
+struct topic_entry
+{
+    types type = types::RAW;
+    bool custom = false;
+    std::array<char, max_size> topic {};
+    std::size_t size = 0;
+
+    constexpr std::string_view view() const { return { topic.data(), size }; }
+};
+
+using protocol_table_t = std::array<topic_entry, 256>;
+
+namespace details
+{
+    constexpr topic_entry make_entry(types type, std::string_view name, bool custom = false)
+    {
+        topic_entry entry {};
+        entry.type = type;
+        entry.custom = custom;
+        entry.size = std::min(std::size(name), max_size);
+        for (auto i = 0UL; i < entry.size; i++)
+            entry.topic[i] = name[i];
+        return entry;
+    }
+
+    constexpr topic_entry make_raw_entry(uint8_t protocol_id)
+    {
+        constexpr char hex[] = "0123456789ABCDEF";
+        topic_entry entry = make_entry(types::RAW, strings::RAW);
+        entry.topic[entry.size++] = hex[protocol_id >> 4];
+        entry.topic[entry.size++] = hex[protocol_id & 0xF];
+        entry.topic[entry.size++] = '/';
+        return entry;
+    }
+
+    constexpr std::size_t index(spacewire::protocol_id_t protocol)
+    {
+        return static_cast<std::size_t>(protocol);
+    }
+
+    constexpr protocol_table_t make_protocol_table()
+    {
+        using namespace spacewire;
+        protocol_table_t table {};
+        for (auto protocol_id = 0UL; protocol_id < std::size(table); protocol_id++)
+            table[protocol_id] = make_raw_entry(static_cast<uint8_t>(protocol_id));
+        table[index(protocol_id_t::SPW_PROTO_ID_RMAP)] = make_entry(types::RMAP, strings::RMAP);
+        table[index(protocol_id_t::SPW_PROTO_ID_CCSDS)] = make_entry(types::CCSDS, strings::CCSDS);
+        table[index(protocol_id_t::SPW_PROTO_ID_EXTEND)]
+            = make_entry(types::EXTEND, strings::EXTEND);
+        table[index(protocol_id_t::SPW_PROTO_ID_GOES_R)]
+            = make_entry(types::GOES_R, strings::GOES_R);
+        table[index(protocol_id_t::SPW_PROTO_ID_STUP)] = make_entry(types::STUP, strings::STUP);
+        return table;
+    }
+}
+
+inline constexpr protocol_table_t default_protocol_table = details::make_protocol_table();
+
+/*
+ * Custom protocols are declared in the "topics" section as NAME: protocol ID, their packets
+ * are published on "/NAME/" and stored with RAW packets on the client side.
+ */
+inline protocol_table_t load_protocol_table(Config cfg)
 {
-    assert(buffer[0]=='/');
-    auto pos=1UL;
-    while((pos < topics::max_size) && (buffer[pos]!='/'))
-        pos++;
-    assert(buffer[pos]=='/');
-    return pos+1;
+    protocol_table_t table = default_protocol_table;
+    if (!cfg.isEmpty())
+    {
+        for (const auto& [name, node] : cfg)
+        {
+            const auto protocol_id = node->to<int>(-1);
+            const auto topic = fmt::format("/{}/", name);
+            if (protocol_id < 0 || protocol_id >= static_cast<int>(std::size(table))
+                || std::size(topic) > max_size)
+            {
+                spdlog::error("Invalid custom topic {}: {}, ignoring it.", topic, protocol_id);
+                continue;
+            }
+            if (table[protocol_id].type != types::RAW)
+                spdlog::warn("Custom topic {} overrides {}", topic, table[protocol_id].view());
+            table[protocol_id] = details::make_entry(types::RAW, topic, true);
+        }
+    }
+    return table;
 }
 
-inline std::string extract_topic(const unsigned char* buffer)
+inline const topic_entry& classify(const protocol_table_t& table, const spw_packet& packet)
 {
-    std::size_t message_begin = topics::end_of_topic(buffer);
-    return { buffer, buffer+ message_begin};
+    assert(packet.size() >= 2);
+    return table[packet.data[1]];
 }
+
+struct subscription
+{
+    types type;
+    std::optional<ccsds::apid_range> apids = std::nullopt;
+
+    subscription(types type) : type { type } { }
+    subscription(const ccsds::apid_range& apids) : type { types::CCSDS }, apids { apids } { }
+
+    std::vector<std::string> prefixes() const
+    {
+        if (apids)
+            return ccsds::subscriptions(*apids);
+        return { to_string(type) };
+    }
+};
 }
 
 
+/*
+ * Packets are serialized unless both ends share the same process (inproc transport), in that
+ * case messages carry the spw_packet object itself.
+ */
+enum class wire_format_t
+{
+    serialized,
+    native
+};
+
+/*
+ * Server sockets can be reached over:
+ *  - tcp (default): tcp://<address>:<pub_port|req_port>
+ *  - ipc: ipc://<ipc_path>-<pub|req>, on the same host it avoids the loopback TCP stack. With
+ *    "transport: tcp" and "ipc: true" the server binds both.
+ *  - inproc: inproc://<inproc_name>-<pub|req>, only within the server process.
+ * Clients connecting to a local address use the server IPC sockets when a server listens on
+ * them unless "prefer_ipc: false" is set.
+ * Several endpoints per socket can also be listed by name in "pub_endpoints" and
+ * "req_endpoints" (e.g. lab: tcp://10.0.0.1:30000, local: ipc:///tmp/spacewirezmq-pub),
+ * they replace the endpoints derived from the transport.
+ * Bridge events (see spw_event) have their own publisher on event_port (30002 by default) or
+ * "event_endpoints", so time-codes never wait behind queued packets.
+ */
+namespace endpoints
+{
+    enum class role
+    {
+        publisher,
+        requests,
+        events
+    };
+
+    inline std::string transport(Config cfg) { return cfg["transport"].to<std::string>("tcp"); }
+
+    inline std::string address(Config cfg)
+    {
+        return cfg["address"].to<std::string>("127.0.0.1");
+    }
+
+    inline int port(Config cfg, role r)
+    {
+        if (r == role::publisher)
+            return cfg["pub_port"].to<int>(30000);
+        if (r == role::events)
+            return cfg["event_port"].to<int>(30002);
+        return cfg["req_port"].to<int>(30001);
+    }
+
+    inline const char* suffix(role r)
+    {
+        if (r == role::publisher)
+            return "pub";
+        if (r == role::events)
+            return "evt";
+        return "req";
+    }
+
+    inline const char* listed_key(role r)
+    {
+        if (r == role::publisher)
+            return "pub_endpoints";
+        if (r == role::events)
+            return "event_endpoints";
+        return "req_endpoints";
+    }
+
+    inline std::string inproc_name(Config cfg)
+    {
+        return cfg["inproc_name"].to<std::string>("spacewirezmq");
+    }
+
+    // the default path is derived from the publisher port so clients find it from the same
+    // configuration as the server
+    inline std::string ipc_file(Config cfg, role r)
+    {
+        const auto path = cfg["ipc_path"].to<std::string>(
+            fmt::format("/tmp/spacewirezmq-{}", port(cfg, role::publisher)));
+        return fmt::format("{}-{}", path, suffix(r));
+    }
+
+    inline std::string tcp(Config cfg, role r)
+    {
+        return fmt::format("tcp://{}:{}", address(cfg), port(cfg, r));
+    }
+
+    inline std::string ipc(Config cfg, role r) { return "ipc://" + ipc_file(cfg, r); }
+
+    inline std::string inproc(Config cfg, role r)
+    {
+        return fmt::format("inproc://{}-{}", inproc_name(cfg), suffix(r));
+    }
+
+    inline bool is_local(const std::string& address)
+    {
+        return address == "localhost" || address == "::1" || address.rfind("127.", 0) == 0;
+    }
+
+    inline std::vector<std::string> listed(Config cfg, role r)
+    {
+        std::vector<std::string> endpoints;
+        auto list = cfg[listed_key(r)];
+        if (!list.isEmpty())
+        {
+            for (const auto& [name, node] : list)
+            {
+                const auto endpoint = node->to<std::string>("");
+                if (std::empty(endpoint))
+                    spdlog::error("Endpoint {} isn't a string, ignoring it.", name);
+                else
+                    endpoints.push_back(endpoint);
+            }
+        }
+        return endpoints;
+    }
+
+    inline bool starts_with(const std::string& endpoint, std::string_view prefix)
+    {
+        return endpoint.compare(0, std::size(prefix), prefix) == 0;
+    }
+
+    inline std::string ipc_file(const std::string& ipc_endpoint)
+    {
+        return ipc_endpoint.substr(std::size("ipc://") - 1);
+    }
+
+    // a socket file left behind by a server that died refuses connections
+    inline bool ipc_listening(const std::string& path)
+    {
+        sockaddr_un address {};
+        if (std::size(path) >= sizeof(address.sun_path))
+            return false;
+        address.sun_family = AF_UNIX;
+        std::copy(std::cbegin(path), std::cend(path), address.sun_path);
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            return false;
+        const bool listening
+            = ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        ::close(fd);
+        return listening;
+    }
+
+    // called before binding, a socket file still served by another process is kept
+    inline void remove_stale_ipc(const std::string& endpoint)
+    {
+        if (!starts_with(endpoint, "ipc://"))
+            return;
+        const auto file = ipc_file(endpoint);
+        std::error_code ec;
+        if (std::filesystem::exists(file, ec) && !ipc_listening(file))
+        {
+            spdlog::warn("Removing stale IPC socket {}", file);
+            std::filesystem::remove(file, ec);
+        }
+    }
+
+    // endpoints the server binds
+    inline std::vector<std::string> binds(Config cfg, role r)
+    {
+        if (auto endpoints = listed(cfg, r); !std::empty(endpoints))
+            return endpoints;
+        const auto t = transport(cfg);
+        if (t == "inproc")
+            return { inproc(cfg, r) };
+        if (t == "ipc")
+            return { ipc(cfg, r) };
+        std::vector<std::string> endpoints { tcp(cfg, r) };
+        if (cfg["ipc"].to<bool>(false))
+            endpoints.push_back(ipc(cfg, r));
+        return endpoints;
+    }
+
+    // endpoint a client connects to
+    inline std::string connect(Config cfg, role r)
+    {
+        if (const auto endpoints = listed(cfg, r); !std::empty(endpoints))
+        {
+            if (cfg["prefer_ipc"].to<bool>(true))
+            {
+                for (const auto& endpoint : endpoints)
+                {
+                    if (starts_with(endpoint, "ipc://") && ipc_listening(ipc_file(endpoint)))
+                        return endpoint;
+                }
+            }
+            for (const auto& endpoint : endpoints)
+            {
+                if (!starts_with(endpoint, "ipc://"))
+                    return endpoint;
+            }
+            return endpoints.front();
+        }
+        const auto t = transport(cfg);
+        if (t == "inproc")
+            return inproc(cfg, r);
+        if (t == "ipc")
+            return ipc(cfg, r);
+        if (cfg["prefer_ipc"].to<bool>(true) && is_local(address(cfg))
+            && ipc_listening(ipc_file(cfg, r)))
+            return ipc(cfg, r);
+        return tcp(cfg, r);
+    }
+
+    /*
+     * Topics routed to a multicast group are sent once whatever the number of subscribers:
+     *   multicast:
+     *     endpoint: "epgm://eth0;239.192.1.1:5555"
+     *     rate: 100000        # kbit/s, the ZMQ default (100) is far too low for science data
+     *     topics: { CCSDS: true, RAW: true }
+     * Routed topics are no longer published on the unicast endpoints, clients given the same
+     * configuration join the group with their SUB socket. This needs libzmq built with PGM
+     * support, UDP RADIO/DISH sockets are still part of the ZMQ draft API.
+     */
+    namespace multicast
+    {
+        using routes_t = std::array<bool, static_cast<std::size_t>(topics::types::UNKNOWN)>;
+
+        inline std::string endpoint(Config cfg)
+        {
+            return cfg["multicast"]["endpoint"].to<std::string>("");
+        }
+
+        inline bool enabled(Config cfg) { return !std::empty(endpoint(cfg)); }
+
+        inline int rate(Config cfg) { return cfg["multicast"]["rate"].to<int>(100000); }
+
+        inline routes_t routes(Config cfg)
+        {
+            routes_t routes {};
+            if (!enabled(cfg))
+                return routes;
+            for (std::size_t index = 0; index < std::size(routes); index++)
+            {
+                routes[index] = cfg["multicast"]["topics"]
+                                   [topics::name(static_cast<topics::types>(index))]
+                                       .to<bool>(false);
+            }
+            return routes;
+        }
+
+        inline bool supported(const std::string& endpoint)
+        {
+            return !(starts_with(endpoint, "pgm://") || starts_with(endpoint, "epgm://"))
+                || zmq_has("pgm");
+        }
+    }
+
+    // packets can only be passed unserialized if every server endpoint is inproc
+    inline wire_format_t wire_format(Config cfg)
+    {
+        if (multicast::enabled(cfg))
+            return wire_format_t::serialized;
+        for (const auto r : { role::publisher, role::requests })
+        {
+            for (const auto& endpoint : binds(cfg, r))
+            {
+                if (!starts_with(endpoint, "inproc://"))
+                    return wire_format_t::serialized;
+            }
+        }
+        return wire_format_t::native;
+    }
+}
+
+/*
+ * Packet bytes are serialized like a std::vector<unsigned char> straight from the packet buffer
+ * (which may be driver memory) and ZMQ takes over the serialization buffer instead of copying it.
+ */
 inline zmq::message_t to_message(const spw_packet& packet)
 {
-    auto buf = yas::save<yas::mem | yas::binary>(
-        YAS_OBJECT_STRUCT("spw_packet", packet, data, port, bridge_id));
-    return zmq::message_t { buf.data.get(), buf.size };
+    const yas::intrusive_buffer data { reinterpret_cast<const char*>(packet.data.data()),
+        packet.size() };
+    auto buf = new yas::shared_buffer { yas::save<yas::mem | yas::binary>(YAS_OBJECT_NVP(
+        "spw_packet", ("data", data), ("port", packet.port), ("bridge_id", packet.bridge_id),
+        ("sequence", packet.sequence))) };
+    return zmq::message_t { buf->data.get(), buf->size,
+        [](void* data_, void* hint_) {
+            (void)data_;
+            delete reinterpret_cast<yas::shared_buffer*>(hint_);
+        },
+        buf };
 }
 
-inline zmq::message_t to_message(const std::string& topic, const spw_packet& packet)
+// ZMQ owns the packet until the last receiver releases the message
+inline zmq::message_t to_native_message(spw_packet&& packet)
 {
-    const auto topic_len = std::size(topic);
-    auto buf = yas::save<yas::mem | yas::binary>(
-        YAS_OBJECT_STRUCT("spw_packet", packet, data, port, bridge_id));
-    const auto buffer_len = topic_len + buf.size;
-    char* buffer = new char[buffer_len]();
-    std::memcpy(buffer, topic.data(), topic_len);
-    std::memcpy(buffer + topic_len, buf.data.get(), buf.size);
-    return zmq::message_t { buffer, buffer_len,
+    return zmq::message_t { new spw_packet { std::move(packet) }, sizeof(spw_packet),
         [](void* data_, void* hint_) {
             (void)hint_;
-            delete[] reinterpret_cast<char*>(data_);
+            delete reinterpret_cast<spw_packet*>(data_);
         },
         nullptr };
 }
 
+inline zmq::message_t to_message(spw_packet&& packet, wire_format_t format)
+{
+    if (format == wire_format_t::native)
+        return to_native_message(std::move(packet));
+    return to_message(packet);
+}
+
+// sequence numbers are sent as 8 bytes little endian frames
+inline zmq::message_t sequence_message(uint64_t sequence)
+{
+    return zmq::message_t { &sequence, sizeof(sequence) };
+}
+
+inline uint64_t to_sequence(const zmq::message_t& message)
+{
+    uint64_t sequence = 0;
+    std::memcpy(&sequence, message.data(), std::min(message.size(), sizeof(sequence)));
+    return sequence;
+}
+
+/*
+ * Published messages are made of three frames: the topic frame used by ZMQ for subscription
+ * filtering, the topic sequence number and the packet. Sequence numbers start at 1 and grow
+ * by one for each packet published on a topic type, CCSDS APIDs share the CCSDS sequence.
+ * A PUB socket never blocks nor reports a full subscriber, it silently drops the message for
+ * each subscriber at its high-water mark, clients count such losses from the bridge sequence
+ * numbers (see spw_packet::sequence).
+ */
+inline void publish(zmq::socket_t& socket, std::string_view topic, uint64_t sequence,
+    spw_packet&& packet, wire_format_t format = wire_format_t::serialized)
+{
+    socket.send(zmq::const_buffer { topic.data(), std::size(topic) }, zmq::send_flags::sndmore);
+    socket.send(sequence_message(sequence), zmq::send_flags::sndmore);
+    socket.send(to_message(std::move(packet), format), zmq::send_flags::none);
+}
+
+/*
+ * Requests are either a single frame holding a packet to send or a multipart command:
+ *  - HISTORY <topic name> <sequence>: packets of the topic type published after the sequence
+ *    number still held by the server, the reply is "ok" followed by topic, sequence and packet
+ *    frames for each of them, "error" if the server keeps no history.
+ */
+namespace requests
+{
+    static constexpr char ok[] = "ok";
+    static constexpr char error[] = "error";
+    static constexpr char history[] = "HISTORY";
+}
+
 inline spw_packet to_packet(const void*buffer, std::size_t len)
 {
     spw_packet p;
+    std::vector<unsigned char> data;
     yas::load<yas::mem | yas::binary>(
         yas::intrusive_buffer {reinterpret_cast<const char*>(buffer), len},
-        YAS_OBJECT_STRUCT("spw_packet", p, data, port, bridge_id));
+        YAS_OBJECT_NVP("spw_packet", ("data", data), ("port", p.port),
+            ("bridge_id", p.bridge_id), ("sequence", p.sequence)));
+    p.data = std::move(data);
     return p;
 }
 
@@ -145,23 +671,81 @@ inline spw_packet to_packet(const zmq::message_t& message)
     return to_packet(message.data(),message.size());
 }
 
-enum class drop_topic_t:bool
+// published messages can be shared by several subscribers, native packets are copied
+inline spw_packet to_packet(const zmq::message_t& message, wire_format_t format)
 {
-    no=false,
-    yes=true
-};
+    if (format == wire_format_t::native)
+        return *reinterpret_cast<const spw_packet*>(message.data());
+    return to_packet(message);
+}
 
-inline spw_packet to_packet(const zmq::message_t& message, drop_topic_t drop_topic)
+// for messages with a single receiver (requests), native packets are moved out of the message
+inline spw_packet take_packet(zmq::message_t& message, wire_format_t format)
 {
-    if(drop_topic==drop_topic_t::yes)
+    if (format == wire_format_t::native)
+        return std::move(*reinterpret_cast<spw_packet*>(message.data()));
+    return to_packet(message);
+}
+
+/*
+ * Bridge events are published as [topic][event] on the event socket, topics are built so
+ * prefixes select what a subscriber gets ("/EVENT/" everything, "/EVENT/LINK/" link status).
+ * Events are always serialized, they are small and rare next to packets.
+ */
+namespace events
+{
+    using kind_t = spw_event::kind_t;
+
+    static constexpr char prefix[] = "/EVENT/";
+
+    inline std::string_view topic(kind_t kind)
     {
-        const auto buffer = reinterpret_cast<const unsigned char*>(message.data());
-        const auto size = std::size(message);
-        std::size_t message_begin = topics::end_of_topic(buffer);
-        return to_packet(buffer+message_begin,size-message_begin);
+        switch (kind)
+        {
+            case kind_t::time_code:
+                return "/EVENT/TIMECODE/";
+            case kind_t::link_up:
+                return "/EVENT/LINK/UP/";
+            case kind_t::link_down:
+                return "/EVENT/LINK/DOWN/";
+            case kind_t::errors:
+                return "/EVENT/ERRORS/";
+        }
+        return prefix;
     }
-    else {
-        return to_packet(message);
+
+    inline zmq::message_t to_message(const spw_event& event)
+    {
+        const auto kind = static_cast<uint8_t>(event.kind);
+        auto buf = yas::save<yas::mem | yas::binary>(YAS_OBJECT_NVP("spw_event",
+            ("kind", kind), ("port", event.port), ("bridge_id", event.bridge_id),
+            ("time_code", event.time_code), ("parity", event.errors.parity),
+            ("disconnect", event.errors.disconnect), ("credit", event.errors.credit),
+            ("escape", event.errors.escape), ("timestamp_ns", event.timestamp_ns)));
+        return zmq::message_t { buf.data.get(), buf.size };
     }
-}
 
+    inline spw_event to_event(const zmq::message_t& message)
+    {
+        spw_event event;
+        uint8_t kind = 0;
+        yas::load<yas::mem | yas::binary>(
+            yas::intrusive_buffer { reinterpret_cast<const char*>(message.data()),
+                message.size() },
+            YAS_OBJECT_NVP("spw_event", ("kind", kind), ("port", event.port),
+                ("bridge_id", event.bridge_id), ("time_code", event.time_code),
+                ("parity", event.errors.parity), ("disconnect", event.errors.disconnect),
+                ("credit", event.errors.credit), ("escape", event.errors.escape),
+                ("timestamp_ns", event.timestamp_ns)));
+        event.kind = static_cast<kind_t>(kind);
+        return event;
+    }
+
+    // like packets, events past a subscriber high-water mark are silently dropped by ZMQ
+    inline void publish(zmq::socket_t& socket, const spw_event& event)
+    {
+        const auto t = topic(event.kind);
+        socket.send(zmq::const_buffer { t.data(), std::size(t) }, zmq::send_flags::sndmore);
+        socket.send(to_message(event), zmq::send_flags::none);
+    }
+}
@@ -0,0 +1,128 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "PacketQueue.hpp"
+#include "SpaceWireZMQ.hpp"
+#include "config/Config.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Last published packets of each topic type, so clients can catch up after joining late or
+ * reconnecting (see requests::history):
+ *   history:
+ *     packets: 1000   # per topic type
+ *     seconds: 60
+ *     mb: 16          # per topic type
+ * The oldest packets are dropped once any bound is reached, 0 disables a bound.
+ */
+class TopicHistory
+{
+public:
+    using clock = std::chrono::steady_clock;
+    struct entry
+    {
+        uint64_t sequence;
+        clock::time_point time;
+        std::string topic;
+        spw_packet packet;
+    };
+
+private:
+    struct topic_history
+    {
+        std::deque<entry> entries;
+        std::size_t bytes = 0;
+    };
+
+    std::size_t m_max_packets;
+    std::chrono::seconds m_max_age;
+    std::size_t m_max_bytes;
+    std::array<topic_history, std::size(topics::strings::table)> m_topics;
+    mutable std::mutex m_mutex;
+
+    static inline std::size_t size(const entry& e)
+    {
+        return sizeof(entry) + std::size(e.topic) + e.packet.size()
+            + std::size(e.packet.bridge_id);
+    }
+
+    void prune(topic_history& history, clock::time_point now)
+    {
+        auto& entries = history.entries;
+        while (!std::empty(entries)
+            && ((m_max_packets && std::size(entries) > m_max_packets)
+                || (m_max_bytes && history.bytes > m_max_bytes)
+                || (m_max_age.count() && now - entries.front().time > m_max_age)))
+        {
+            history.bytes -= size(entries.front());
+            entries.pop_front();
+        }
+    }
+
+public:
+    explicit TopicHistory(Config cfg)
+            : m_max_packets { static_cast<std::size_t>(
+                std::max(cfg["packets"].to<int>(1000), 0)) }
+            , m_max_age { std::max(cfg["seconds"].to<int>(60), 0) }
+            , m_max_bytes { static_cast<std::size_t>(std::max(cfg["mb"].to<int>(16), 0)) << 20 }
+    {
+    }
+
+    inline static bool enabled(Config cfg) { return !cfg.isEmpty(); }
+
+    void add(topics::types type, uint64_t sequence, std::string_view topic,
+        const spw_packet& packet)
+    {
+        const auto index = static_cast<std::size_t>(type);
+        if (index >= std::size(m_topics))
+            return;
+        const auto now = clock::now();
+        std::lock_guard<std::mutex> lock { m_mutex };
+        auto& history = m_topics[index];
+        history.entries.push_back({ sequence, now, std::string { topic }, packet });
+        history.bytes += size(history.entries.back());
+        prune(history, now);
+    }
+
+    // copies of the packets published after sequence, oldest first
+    std::vector<entry> since(topics::types type, uint64_t sequence)
+    {
+        const auto index = static_cast<std::size_t>(type);
+        if (index >= std::size(m_topics))
+            return {};
+        std::lock_guard<std::mutex> lock { m_mutex };
+        auto& history = m_topics[index];
+        prune(history, clock::now());
+        const auto first
+            = std::partition_point(std::cbegin(history.entries), std::cend(history.entries),
+                [sequence](const entry& e) { return e.sequence <= sequence; });
+        return { first, std::cend(history.entries) };
+    }
+};
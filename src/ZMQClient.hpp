@@ -24,9 +24,23 @@
 #include "SpaceWireZMQ.hpp"
 #include "config/Config.hpp"
 #include "fmt/format.h"
+#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <optional>
+#include <string>
 #include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 #include <zmq.hpp>
 using namespace std::chrono_literals;
 
@@ -46,128 +60,481 @@ static inline constexpr bool is_all_topic_merged = std::is_same_v<_topic_policy,
 
 }
 
-template <typename topic_policy_t>
+namespace threading_policy
+{
+// a background thread waits for published packets and stores them in thread safe queues
+struct subscription_thread
+{
+};
+// no thread, published packets are read from the socket when the client asks for them
+struct on_demand
+{
+};
+
+template <typename _threading_policy>
+static inline constexpr bool is_threaded
+    = std::is_same_v<_threading_policy, subscription_thread>;
+template <typename _threading_policy>
+static inline constexpr bool is_on_demand = std::is_same_v<_threading_policy, on_demand>;
+}
+
+struct subscriber_statistics
+{
+    // latest values replaced before the client read them (see ZMQClient::latest_packet)
+    uint64_t conflated = 0;
+    /*
+     * Packets lost between the bridge and the client, from gaps in the bridge sequence numbers
+     * (see spw_packet::sequence). Not counted for topics subscribed by CCSDS APID ranges since
+     * the other APIDs share the sequence.
+     */
+    uint64_t missed = 0;
+    std::array<uint64_t, std::size(topics::strings::table)> missed_by_topic {};
+};
+
+template <typename topic_policy_t,
+    typename threading_policy_t = threading_policy::subscription_thread>
 class ZMQClient
 {
-    zmq::context_t m_ctx;
+    static constexpr std::size_t queues_count = topic_policy::is_all_topic_merged<topic_policy_t>
+        ? 1
+        : std::size(topics::strings::table);
+    using packet_storage_t = std::conditional_t<threading_policy::is_threaded<threading_policy_t>,
+        packet_queue, std::vector<spw_packet>>;
+
+public:
+    using packet_callback_t = std::function<void(spw_packet&&)>;
+
+private:
+    // only owned when no context is shared with the client
+    std::optional<zmq::context_t> m_ctx;
     zmq::socket_t m_subscription;
     zmq::socket_t m_requests;
-    std::array<bool,
-        topic_policy::is_all_topic_merged<topic_policy_t> ? 1 : std::size(topics::strings::table)>
-        m_topic_enabled;
-    std::array<packet_queue,
-        topic_policy::is_all_topic_merged<topic_policy_t> ? 1 : std::size(topics::strings::table)>
-        m_received_packets;
-    bool m_running = false;
+    zmq::socket_t m_shutdown_sender;
+    zmq::socket_t m_shutdown_receiver;
+    std::array<bool, queues_count> m_topic_enabled;
+    std::array<packet_storage_t, queues_count> m_received_packets;
+    // callbacks can be set from any thread while the subscription thread reads them
+    std::array<std::shared_ptr<const packet_callback_t>, queues_count> m_callbacks;
+    topics::protocol_table_t m_protocols;
+    wire_format_t m_wire_format = wire_format_t::serialized;
     std::thread m_sub_thread;
+    // wakes timed next_packet calls when a packet is queued or the client closes
+    std::mutex m_arrival_mutex;
+    std::condition_variable m_arrival;
+    // conflated topics only keep their latest packet, per APID for CCSDS
+    std::array<bool, std::size(topics::strings::table)> m_conflated {};
+    std::mutex m_latest_mutex;
+    std::map<std::string, spw_packet, std::less<>> m_latest;
+    std::atomic<uint64_t> m_conflated_count { 0 };
+    // last publish sequence number (topic frame) per topic type, see history()
+    std::array<std::atomic<uint64_t>, std::size(topics::strings::table)> m_last_sequences {};
+    // last bridge sequence number received per bridge and protocol ID
+    std::unordered_map<std::string, std::array<uint64_t, 256>> m_bridge_sequences;
+    std::array<bool, std::size(topics::strings::table)> m_gap_tracking {};
+    std::array<std::atomic<uint64_t>, std::size(topics::strings::table)> m_missed {};
+    // subscribed topic prefixes, history requests only return matching packets
+    std::vector<std::string> m_prefixes;
+
+    void track_gaps(std::size_t index, const spw_packet& packet)
+    {
+        // unstamped packets (0) are too short to carry a protocol ID
+        if (index >= std::size(m_gap_tracking) || !m_gap_tracking[index] || !packet.sequence
+            || packet.size() < 2)
+            return;
+        auto& last = m_bridge_sequences[packet.bridge_id][packet.data[1]];
+        // a lower sequence number means the server or the bridge restarted
+        if (last && packet.sequence > last + 1)
+            m_missed[index] += packet.sequence - last - 1;
+        last = packet.sequence;
+    }
+
+    void keep_latest(std::string_view topic, spw_packet&& packet)
+    {
+        std::lock_guard<std::mutex> lock { m_latest_mutex };
+        if (auto it = m_latest.find(topic); it != std::end(m_latest))
+        {
+            it->second = std::move(packet);
+            m_conflated_count++;
+        }
+        else
+        {
+            m_latest.emplace(std::string { topic }, std::move(packet));
+        }
+    }
+
+    // taking the lock before notifying keeps a timed next_packet from missing the packet
+    void notify_arrival()
+    {
+        {
+            std::lock_guard<std::mutex> lock { m_arrival_mutex };
+        }
+        m_arrival.notify_all();
+    }
 
-    std::size_t topic_index(const zmq::message_t& message)
+    void store(std::size_t index, spw_packet&& packet)
     {
-        using namespace topics;
-        using namespace topics::strings;
-        return static_cast<std::size_t>(
-            to_type(extract_topic(reinterpret_cast<const unsigned char*>(message.data()))));
+        if (const auto callback = std::atomic_load(&m_callbacks[index]))
+            (*callback)(std::move(packet));
+        else if constexpr (threading_policy::is_threaded<threading_policy_t>)
+        {
+            m_received_packets[index] << std::move(packet);
+            notify_arrival();
+        }
+        else
+            m_received_packets[index].push_back(std::move(packet));
     }
 
-    void store_packet(const zmq::message_t& message)
+    void store_packet(std::string_view topic, uint64_t sequence, const zmq::message_t& message)
     {
-        const std::size_t index = topic_index(message);
-        assert(m_topic_enabled[index]);
+        auto packet = to_packet(message, m_wire_format);
+        const auto index = static_cast<std::size_t>(topics::classify(m_protocols, packet).type);
+        if (index < std::size(m_last_sequences))
+            m_last_sequences[index] = sequence;
+        track_gaps(index, packet);
+        if ((index < std::size(m_conflated)) && m_conflated[index])
+        {
+            keep_latest(topic, std::move(packet));
+            return;
+        }
         if constexpr (topic_policy::is_per_topic<topic_policy_t>)
         {
+            assert(index < std::size(m_received_packets) && m_topic_enabled[index]);
             if ((index < std::size(m_received_packets)) && m_topic_enabled[index])
-                m_received_packets[index] << to_packet(message, drop_topic_t::yes);
+                store(index, std::move(packet));
         }
         else
         {
-            m_received_packets[0] << to_packet(message, drop_topic_t::yes);
+            store(0, std::move(packet));
         }
     }
 
-    void subscription_thread()
+    // reads every packet already waiting in the subscription socket without blocking
+    void receive_available()
     {
+        zmq::message_t topic;
+        zmq::message_t sequence;
         zmq::message_t message;
-        while (m_running)
+        while (m_subscription.recv(topic, zmq::recv_flags::dontwait))
         {
-            int tries = 0;
-            do
+            // multipart messages are delivered atomically, the payload is already there
+            if (topic.more() && m_subscription.recv(sequence, zmq::recv_flags::none)
+                && sequence.more() && m_subscription.recv(message, zmq::recv_flags::none))
+                store_packet(topic.to_string_view(), to_sequence(sequence), message);
+        }
+    }
+
+    void subscription_thread()
+    {
+        zmq::pollitem_t items[] = { { m_subscription, 0, ZMQ_POLLIN, 0 },
+            { m_shutdown_receiver, 0, ZMQ_POLLIN, 0 } };
+        while (true)
+        {
+            zmq::poll(items, std::size(items), std::chrono::milliseconds { -1 });
+            if (items[1].revents & ZMQ_POLLIN)
+                return;
+            if (items[0].revents & ZMQ_POLLIN)
+                receive_available();
+        }
+    }
+
+    /*
+     * Only the client takes packets from its queues, so the queue size read once gives how
+     * many packets can be taken without blocking.
+     */
+    template <typename OutputIt>
+    std::size_t drain_into(std::size_t index, OutputIt out, std::size_t max)
+    {
+        assert(index < std::size(m_received_packets));
+        auto& packets = m_received_packets[index];
+        if constexpr (threading_policy::is_threaded<threading_policy_t>)
+        {
+            const std::size_t count = std::min(std::size(packets), max);
+            for (auto i = 0UL; i < count; i++)
             {
-                if (m_subscription.recv(message, zmq::recv_flags::dontwait))
-                {
-                    store_packet(message);
-                    tries = 0;
-                }
-                else
-                {
-                    tries++;
-                }
-            } while (tries < 100);
-            std::this_thread::sleep_for(10us);
+                *out++ = std::move(*packets.take());
+            }
+            return count;
+        }
+        else
+        {
+            receive_available();
+            const std::size_t count = std::min(std::size(packets), max);
+            const auto last = std::begin(packets) + count;
+            std::move(std::begin(packets), last, out);
+            packets.erase(std::begin(packets), last);
+            return count;
         }
     }
 
     std::vector<spw_packet> get_packets(std::size_t index)
     {
         assert(index < std::size(m_received_packets));
-        std::vector<spw_packet> packets;
-        while (std::size(m_received_packets[index]))
+        if constexpr (threading_policy::is_threaded<threading_policy_t>)
         {
-            packets.push_back(*m_received_packets[index].take());
+            std::vector<spw_packet> packets;
+            packets.reserve(std::size(m_received_packets[index]));
+            drain_into(index, std::back_inserter(packets), packets.capacity());
+            return packets;
+        }
+        else
+        {
+            receive_available();
+            return std::exchange(m_received_packets[index], {});
         }
-        return packets;
     }
 
-public:
-    ZMQClient(const std::initializer_list<topics::types>& subscribed_topics, Config cfg,
-        topic_policy_t = topic_policy::per_topic_queue {})
+    std::optional<spw_packet> next_packet(std::size_t index)
     {
-        const auto address = cfg["address"].to<std::string>("127.0.0.1");
-        const auto pub_port = cfg["pub_port"].to<int>(30000);
-        const auto req_port = cfg["req_port"].to<int>(30001);
+        static_assert(threading_policy::is_threaded<threading_policy_t>,
+            "next_packet needs the subscription thread, use poll with on_demand policy");
+        assert(index < std::size(m_received_packets));
+        return m_received_packets[index].take();
+    }
 
-        m_ctx = zmq::context_t { 1 };
-        m_requests = zmq::socket_t { m_ctx, zmq::socket_type::req };
+    std::optional<spw_packet> next_packet(std::size_t index, std::chrono::milliseconds timeout)
+    {
+        static_assert(threading_policy::is_threaded<threading_policy_t>,
+            "next_packet needs the subscription thread, use poll with on_demand policy");
+        assert(index < std::size(m_received_packets));
+        auto& queue = m_received_packets[index];
+        {
+            std::unique_lock<std::mutex> lock { m_arrival_mutex };
+            if (!m_arrival.wait_for(lock, timeout,
+                    [&queue]() { return std::size(queue) || queue.closed(); }))
+                return std::nullopt;
+        }
+        // only this thread takes from the queue, so a non empty queue can't block take()
+        if (!std::size(queue))
+            return std::nullopt;
+        return queue.take();
+    }
 
-        m_requests.connect(fmt::format("tcp://{}:{}", address, req_port));
+    void on_packet(std::size_t index, packet_callback_t&& callback)
+    {
+        assert(index < std::size(m_callbacks));
+        std::atomic_store(&m_callbacks[index],
+            callback ? std::make_shared<const packet_callback_t>(std::move(callback))
+                     : std::shared_ptr<const packet_callback_t> {});
+    }
+
+    bool has_packets(std::size_t index)
+    {
+        assert(index < std::size(m_received_packets));
+        if constexpr (threading_policy::is_on_demand<threading_policy_t>)
+            receive_available();
+        return std::size(m_received_packets[index]);
+    }
 
-        m_subscription = zmq::socket_t { m_ctx, zmq::socket_type::sub };
-        m_subscription.connect(fmt::format("tcp://{}:{}", address, pub_port));
+    void setup(const std::initializer_list<topics::subscription>& subscriptions, Config cfg,
+        zmq::context_t& ctx)
+    {
+        m_protocols = topics::load_protocol_table(cfg["topics"]);
+        m_wire_format = endpoints::wire_format(cfg);
+
+        m_requests = zmq::socket_t { ctx, zmq::socket_type::req };
+
+        m_requests.connect(endpoints::connect(cfg, endpoints::role::requests));
+
+        m_subscription = zmq::socket_t { ctx, zmq::socket_type::sub };
+        m_subscription.set(zmq::sockopt::rcvhwm, cfg["sub_rcvhwm"].to<int>(1000));
+        m_subscription.connect(endpoints::connect(cfg, endpoints::role::publisher));
+        if (const auto group = endpoints::multicast::endpoint(cfg);
+            !std::empty(group) && endpoints::multicast::supported(group))
+        {
+            m_subscription.set(zmq::sockopt::rate, endpoints::multicast::rate(cfg));
+            m_subscription.connect(group);
+        }
 
         for (auto& enabled : m_topic_enabled)
         {
             enabled = false;
         }
-        for (const auto& topic : subscribed_topics)
+        // ZMQ_CONFLATE doesn't support multipart messages, topics are conflated here instead
+        for (auto index = 0UL; index < std::size(m_conflated); index++)
+        {
+            m_conflated[index]
+                = cfg["conflate"][topics::name(static_cast<topics::types>(index))].to<bool>(
+                    false);
+        }
+        for (const auto& subscription : subscriptions)
+        {
+            for (const auto& prefix : subscription.prefixes())
+                m_prefixes.push_back(prefix);
+            if (subscription.type == topics::types::RAW)
+            {
+                for (const auto& entry : m_protocols)
+                {
+                    if (entry.custom)
+                        m_prefixes.emplace_back(entry.view());
+                }
+            }
+            const auto index = static_cast<std::size_t>(subscription.type);
+            if (index < std::size(m_gap_tracking))
+                m_gap_tracking[index] = m_gap_tracking[index] || !subscription.apids;
+            if constexpr (topic_policy::is_per_topic<topic_policy_t>)
+                m_topic_enabled[index] = true;
+            else
+                m_topic_enabled[0] = true;
+        }
+        for (const auto& prefix : m_prefixes)
+            m_subscription.set(zmq::sockopt::subscribe, prefix);
+        if constexpr (threading_policy::is_threaded<threading_policy_t>)
+        {
+            const auto shutdown_endpoint
+                = fmt::format("inproc://ZMQClient-shutdown-{}", static_cast<void*>(this));
+            m_shutdown_receiver = zmq::socket_t { ctx, zmq::socket_type::pair };
+            m_shutdown_receiver.bind(shutdown_endpoint);
+            m_shutdown_sender = zmq::socket_t { ctx, zmq::socket_type::pair };
+            m_shutdown_sender.connect(shutdown_endpoint);
+            m_sub_thread = std::thread(&ZMQClient::subscription_thread, this);
+        }
+    }
+
+    void send_request(zmq::message_t&& request)
+    {
+        if (m_requests.connected())
         {
-            m_subscription.set(zmq::sockopt::subscribe, topics::to_string(topic));
-            m_topic_enabled[static_cast<std::size_t>(topic)] = true;
+            zmq::mutable_buffer resp;
+            m_requests.send(request, zmq::send_flags::none);
+            m_requests.recv(resp);
         }
-        m_running = true;
-        m_sub_thread = std::thread(&ZMQClient::subscription_thread, this);
+    }
+
+public:
+    /*
+     * Subscriptions can either be whole topics (topics::types::CCSDS) or CCSDS APID ranges
+     * (topics::ccsds::apid_range { 0x100, 0x1FF }) optionally restricted to one packet type,
+     * APID filtering is done on the server side by ZMQ.
+     */
+    ZMQClient(const std::initializer_list<topics::subscription>& subscriptions, Config cfg,
+        topic_policy_t = topic_policy::per_topic_queue {},
+        threading_policy_t = threading_policy::subscription_thread {})
+    {
+        if (endpoints::transport(cfg) == "inproc")
+            spdlog::error("inproc transport needs the server context, client won't get packets");
+        m_ctx.emplace(1);
+        setup(subscriptions, cfg, *m_ctx);
+    }
+
+    /*
+     * Client sharing the given context, required with the inproc transport where the server
+     * runs in the same process (see ZMQServer::context()).
+     */
+    ZMQClient(const std::initializer_list<topics::subscription>& subscriptions, Config cfg,
+        zmq::context_t& shared_ctx, topic_policy_t = topic_policy::per_topic_queue {},
+        threading_policy_t = threading_policy::subscription_thread {})
+    {
+        setup(subscriptions, cfg, shared_ctx);
     }
 
     ~ZMQClient()
     {
-        m_running = false;
-        for (auto& queue : m_received_packets)
+        if constexpr (threading_policy::is_threaded<threading_policy_t>)
         {
-            queue.close();
+            // closing queues first unblocks the subscription thread if it waits for space
+            for (auto& queue : m_received_packets)
+            {
+                queue.close();
+            }
+            notify_arrival();
+            m_shutdown_sender.send(zmq::message_t {}, zmq::send_flags::none);
+            m_sub_thread.join();
+            m_shutdown_sender.close();
+            m_shutdown_receiver.close();
         }
-        m_sub_thread.join();
         m_requests.close();
         m_subscription.close();
     }
 
-    void send_packet(const spw_packet& packet)
+    /*
+     * Packets of conflated topics ("conflate: { CCSDS: true }" in the configuration) aren't
+     * queued nor given to callbacks, only the latest one of each published topic is kept, for
+     * example topics::ccsds::to_topic(0x1AB, topics::ccsds::packet_type::TM) for CCSDS
+     * housekeeping. Returns a copy so it can be read again until replaced.
+     */
+    std::optional<spw_packet> latest_packet(std::string_view topic)
     {
-        if (m_requests.connected())
+        if constexpr (threading_policy::is_on_demand<threading_policy_t>)
+            receive_available();
+        std::lock_guard<std::mutex> lock { m_latest_mutex };
+        if (auto it = m_latest.find(topic); it != std::end(m_latest))
+            return it->second;
+        return std::nullopt;
+    }
+
+    inline subscriber_statistics statistics() const
+    {
+        subscriber_statistics stats { m_conflated_count.load() };
+        for (auto index = 0UL; index < std::size(m_missed); index++)
         {
-            zmq::mutable_buffer resp;
-            m_requests.send(to_message(packet), zmq::send_flags::none);
-            m_requests.recv(resp);
+            stats.missed_by_topic[index] = m_missed[index];
+            stats.missed += stats.missed_by_topic[index];
+        }
+        return stats;
+    }
+
+    // sequence number of the last packet received on the topic type, 0 if none
+    inline uint64_t last_sequence(topics::types topic) const
+    {
+        const auto index = static_cast<std::size_t>(topic);
+        return index < std::size(m_last_sequences) ? m_last_sequences[index].load() : 0;
+    }
+
+    /*
+     * Packets published on a topic type after since_sequence that the server still holds in
+     * its history ("history" section of the server configuration), oldest first and limited
+     * to the client subscriptions. After a reconnection:
+     *   for (auto& packet : client.history(topics::types::CCSDS,
+     *            client.last_sequence(topics::types::CCSDS)))
+     * Returns std::nullopt if the server keeps no history.
+     */
+    std::optional<std::vector<spw_packet>> history(
+        topics::types topic, uint64_t since_sequence = 0)
+    {
+        if (!m_requests.connected())
+            return std::nullopt;
+        const auto name = topics::name(topic);
+        m_requests.send(zmq::buffer(std::string_view { requests::history }),
+            zmq::send_flags::sndmore);
+        m_requests.send(zmq::buffer(name), zmq::send_flags::sndmore);
+        m_requests.send(sequence_message(since_sequence), zmq::send_flags::none);
+        zmq::message_t status;
+        (void)m_requests.recv(status, zmq::recv_flags::none);
+        const bool ok = status.to_string_view() == requests::ok;
+        std::vector<spw_packet> packets;
+        zmq::message_t topic_frame, sequence, message;
+        for (bool more = status.more(); more; more = message.more())
+        {
+            (void)m_requests.recv(topic_frame, zmq::recv_flags::none);
+            (void)m_requests.recv(sequence, zmq::recv_flags::none);
+            (void)m_requests.recv(message, zmq::recv_flags::none);
+            const auto topic_name = topic_frame.to_string_view();
+            if (std::any_of(std::cbegin(m_prefixes), std::cend(m_prefixes),
+                    [topic_name](const std::string& prefix) {
+                        return topic_name.substr(0, std::size(prefix)) == prefix;
+                    }))
+                packets.push_back(to_packet(message, m_wire_format));
         }
+        if (!ok)
+            return std::nullopt;
+        return packets;
     }
 
+    void send_packet(const spw_packet& packet)
+    {
+        if (m_wire_format == wire_format_t::native)
+            send_packet(spw_packet { packet });
+        else
+            send_request(to_message(packet));
+    }
+
+    // with the inproc transport the packet is handed over to the server without any copy
+    void send_packet(spw_packet&& packet)
+    {
+        send_request(to_message(std::move(packet), m_wire_format));
+    }
+
+
     template <typename _topic_policy_t = topic_policy_t>
     std::enable_if_t<topic_policy::is_per_topic<_topic_policy_t>, std::vector<spw_packet>>
     get_packets(topics::types topic)
@@ -182,16 +549,151 @@ public:
         return get_packets(0);
     }
 
+    /*
+     * Moves up to max received packets to out and returns how many were moved, unlike
+     * get_packets it doesn't allocate so the caller can reuse the same buffer on each call:
+     *   std::array<spw_packet, 64> buffer;
+     *   const auto count = client.drain_into(topics::types::CCSDS, std::begin(buffer), 64);
+     */
+    template <typename OutputIt, typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_per_topic<_topic_policy_t>, std::size_t> drain_into(
+        topics::types topic, OutputIt out,
+        std::size_t max = std::numeric_limits<std::size_t>::max())
+    {
+        return drain_into(static_cast<std::size_t>(topic), out, max);
+    }
+
+    template <typename OutputIt, typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_all_topic_merged<_topic_policy_t>, std::size_t> drain_into(
+        OutputIt out, std::size_t max = std::numeric_limits<std::size_t>::max())
+    {
+        return drain_into(0UL, out, max);
+    }
+
+    /*
+     * Blocks until a packet is received on the given topic, returns std::nullopt once the
+     * client is closed.
+     */
+    template <typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_per_topic<_topic_policy_t>, std::optional<spw_packet>>
+    next_packet(topics::types topic)
+    {
+        return next_packet(static_cast<std::size_t>(topic));
+    }
+
+    template <typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_all_topic_merged<_topic_policy_t>, std::optional<spw_packet>>
+    next_packet()
+    {
+        return next_packet(0);
+    }
+
+    // same as next_packet but gives up after timeout
+    template <typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_per_topic<_topic_policy_t>, std::optional<spw_packet>>
+    next_packet(topics::types topic, std::chrono::milliseconds timeout)
+    {
+        return next_packet(static_cast<std::size_t>(topic), timeout);
+    }
+
+    template <typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_all_topic_merged<_topic_policy_t>, std::optional<spw_packet>>
+    next_packet(std::chrono::milliseconds timeout)
+    {
+        return next_packet(0, timeout);
+    }
+
+    /*
+     * Packets of a topic with a callback are given to it instead of being queued, the callback
+     * is called from the subscription thread (or from poll with the on_demand policy) so it
+     * should return quickly. An empty callback restores queuing.
+     */
+    template <typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_per_topic<_topic_policy_t>, void> on_packet(
+        topics::types topic, packet_callback_t callback)
+    {
+        on_packet(static_cast<std::size_t>(topic), std::move(callback));
+    }
+
+    template <typename _topic_policy_t = topic_policy_t>
+    std::enable_if_t<topic_policy::is_all_topic_merged<_topic_policy_t>, void> on_packet(
+        packet_callback_t callback)
+    {
+        on_packet(0, std::move(callback));
+    }
+
+    // waits up to timeout for published packets and dispatches them, returns true if any
+    template <typename _threading_policy_t = threading_policy_t>
+    std::enable_if_t<threading_policy::is_on_demand<_threading_policy_t>, bool> poll(
+        std::chrono::milliseconds timeout)
+    {
+        zmq::pollitem_t items[] = { { m_subscription, 0, ZMQ_POLLIN, 0 } };
+        if (zmq::poll(items, std::size(items), timeout) > 0)
+        {
+            receive_available();
+            return true;
+        }
+        return false;
+    }
+
     template <typename _topic_policy_t = topic_policy_t>
     std::enable_if_t<topic_policy::is_per_topic<_topic_policy_t>, bool> has_packets(
         topics::types topic)
     {
-        return std::size(m_received_packets[static_cast<std::size_t>(topic)]);
+        return has_packets(static_cast<std::size_t>(topic));
     }
 
     template <typename _topic_policy_t = topic_policy_t>
     std::enable_if_t<topic_policy::is_all_topic_merged<_topic_policy_t>, bool> has_packets()
     {
-        return std::size(m_received_packets[0]);
+        return has_packets(0);
+    }
+};
+
+/*
+ * Subscriber to bridge events (see spw_event) without any thread in between, next_event
+ * returns as soon as ZMQ got the event which keeps time-code latency low. Prefixes select
+ * events (see events::topic), events::prefix gets all of them.
+ */
+class ZMQEventClient
+{
+    // only owned when no context is shared with the client
+    std::optional<zmq::context_t> m_ctx;
+    zmq::socket_t m_subscription;
+
+    void setup(const std::vector<std::string>& prefixes, Config cfg, zmq::context_t& ctx)
+    {
+        m_subscription = zmq::socket_t { ctx, zmq::socket_type::sub };
+        m_subscription.connect(endpoints::connect(cfg, endpoints::role::events));
+        for (const auto& prefix : prefixes)
+            m_subscription.set(zmq::sockopt::subscribe, prefix);
+    }
+
+public:
+    ZMQEventClient(Config cfg, const std::vector<std::string>& prefixes = { events::prefix })
+    {
+        m_ctx.emplace(1);
+        setup(prefixes, cfg, *m_ctx);
+    }
+
+    // required with the inproc transport (see ZMQServer::context())
+    ZMQEventClient(Config cfg, zmq::context_t& shared_ctx,
+        const std::vector<std::string>& prefixes = { events::prefix })
+    {
+        setup(prefixes, cfg, shared_ctx);
+    }
+
+    ~ZMQEventClient() { m_subscription.close(); }
+
+    std::optional<spw_event> next_event(std::chrono::milliseconds timeout)
+    {
+        zmq::pollitem_t items[] = { { m_subscription, 0, ZMQ_POLLIN, 0 } };
+        if (zmq::poll(items, std::size(items), timeout) <= 0)
+            return std::nullopt;
+        zmq::message_t topic, event;
+        if (!m_subscription.recv(topic, zmq::recv_flags::dontwait) || !topic.more()
+            || !m_subscription.recv(event, zmq::recv_flags::none))
+            return std::nullopt;
+        return events::to_event(event);
     }
 };
@@ -36,15 +36,47 @@
 
 bool ZMQServer::start()
 {
-    const auto address = m_cfg["address"].to<std::string>("127.0.0.1");
-    const auto pub_port = m_cfg["pub_port"].to<int>(30000);
-    const auto req_port = m_cfg["req_port"].to<int>(30001);
-
-    m_publisher.bind(fmt::format("tcp://{}:{}", address, pub_port));
-    m_requests.bind(fmt::format("tcp://{}:{}", address, req_port));
+    m_wire_format = endpoints::wire_format(m_cfg);
+    for (const auto& endpoint : endpoints::binds(m_cfg, endpoints::role::publisher))
+    {
+        spdlog::info("Publishing packets on {}", endpoint);
+        endpoints::remove_stale_ipc(endpoint);
+        m_publisher.bind(endpoint);
+    }
+    for (const auto& endpoint : endpoints::binds(m_cfg, endpoints::role::requests))
+    {
+        spdlog::info("Listening to requests on {}", endpoint);
+        endpoints::remove_stale_ipc(endpoint);
+        m_requests.bind(endpoint);
+    }
+    for (const auto& endpoint : endpoints::binds(m_cfg, endpoints::role::events))
+    {
+        spdlog::info("Publishing bridge events on {}", endpoint);
+        endpoints::remove_stale_ipc(endpoint);
+        m_events.bind(endpoint);
+    }
+    if (endpoints::multicast::enabled(m_cfg))
+    {
+        const auto endpoint = endpoints::multicast::endpoint(m_cfg);
+        if (endpoints::multicast::supported(endpoint))
+        {
+            spdlog::info("Publishing multicast topics on {}", endpoint);
+            m_multicast = zmq::socket_t { m_ctx, zmq::socket_type::pub };
+            m_multicast.set(zmq::sockopt::rate, endpoints::multicast::rate(m_cfg));
+            m_multicast.set(zmq::sockopt::sndhwm, m_cfg["pub_sndhwm"].to<int>(1000));
+            m_multicast.connect(endpoint);
+            m_multicast_routes = endpoints::multicast::routes(m_cfg);
+        }
+        else
+        {
+            spdlog::error(
+                "libzmq lacks PGM support, can't publish on {}, using unicast", endpoint);
+        }
+    }
 
     m_req_thread = std::thread(&ZMQServer::handle_requests, this);
     m_publisher_thread = std::thread(&ZMQServer::publish_packets, this);
+    m_event_thread = std::thread(&ZMQServer::publish_events, this);
     return true;
 }
 
@@ -72,12 +104,19 @@ void ZMQServer::close()
 {
     m_running = false;
     received_packets.close();
+    received_events.close();
     if (m_req_thread.joinable())
         m_req_thread.join();
     if (m_publisher_thread.joinable())
         m_publisher_thread.join();
+    if (m_event_thread.joinable())
+        m_event_thread.join();
+    if (m_recorder)
+        m_recorder->close();
     m_publisher.close();
     m_requests.close();
+    m_multicast.close();
+    m_events.close();
 }
 
 void ZMQServer::publish_packets()
@@ -87,35 +126,71 @@ void ZMQServer::publish_packets()
         auto packet = received_packets.take();
         if (packet)
         {
-            const spacewire::protocol_id_t protocol
-                = spacewire::fields::protocol_identifier(packet->data.data());
-            switch (protocol)
+            if (m_recorder)
+                m_recorder->record(*packet);
+            if (packet->size() < 2)
+            {
+                spdlog::debug("Dropping a {} bytes packet from {}", packet->size(),
+                    packet->bridge_id);
+                m_malformed++;
+                continue;
+            }
+            const auto& entry = topics::classify(m_protocols, *packet);
+            const auto index = static_cast<std::size_t>(entry.type);
+            auto& socket = m_multicast_routes[index] ? m_multicast : m_publisher;
+            std::string ccsds_topic;
+            std::string_view topic = entry.view();
+            if (entry.type == topics::types::CCSDS)
             {
-                case spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS:
-                    m_publisher.send(
-                        to_message(topics::strings::CCSDS, *packet), zmq::send_flags::none);
-                    break;
-                case spacewire::protocol_id_t::SPW_PROTO_ID_RMAP:
-                    m_publisher.send(
-                        to_message(topics::strings::RMAP, *packet), zmq::send_flags::none);
-                    break;
-                case spacewire::protocol_id_t::SPW_PROTO_ID_EXTEND:
-                    m_publisher.send(
-                        to_message(topics::strings::EXTEND, *packet), zmq::send_flags::none);
-                    break;
-                case spacewire::protocol_id_t::SPW_PROTO_ID_GOES_R:
-                    m_publisher.send(
-                        to_message(topics::strings::GOES_R, *packet), zmq::send_flags::none);
-                    break;
-                case spacewire::protocol_id_t::SPW_PROTO_ID_STUP:
-                    m_publisher.send(
-                        to_message(topics::strings::STUP, *packet), zmq::send_flags::none);
-                    break;
-                default:
-                    break;
+                ccsds_topic = topics::ccsds::to_topic(packet->data.data(), packet->size());
+                topic = ccsds_topic;
             }
+            const auto sequence = ++m_sequences[index];
+            // subscribers past their high-water mark can get it back from the history
+            if (m_history)
+                m_history->add(entry.type, sequence, topic, *packet);
+            // never waits for slow subscribers, their losses are only seen by clients as gaps
+            publish(socket, topic, sequence, std::move(*packet), m_wire_format);
+            m_unknown_protocol += (entry.type == topics::types::RAW) && !entry.custom;
+            m_published++;
+        }
+    }
+}
+
+// waits on the queue rather than polling so time-codes go out as soon as a bridge gets them
+void ZMQServer::publish_events()
+{
+    while (m_running && !received_events.closed())
+    {
+        if (auto event = received_events.take())
+        {
+            events::publish(m_events, *event);
+            m_events_published++;
+        }
+    }
+}
+
+void ZMQServer::handle_command(std::vector<zmq::message_t>& frames)
+{
+    const auto command = frames[0].to_string_view();
+    if (command == requests::history && std::size(frames) == 3 && m_history)
+    {
+        const auto type = topics::from_name(frames[1].to_string_view());
+        const auto entries = m_history->since(type, to_sequence(frames[2]));
+        m_requests.send(zmq::buffer(std::string_view { requests::ok }),
+            std::empty(entries) ? zmq::send_flags::none : zmq::send_flags::sndmore);
+        for (auto i = 0UL; i < std::size(entries); i++)
+        {
+            const auto& entry = entries[i];
+            m_requests.send(zmq::buffer(entry.topic), zmq::send_flags::sndmore);
+            m_requests.send(sequence_message(entry.sequence), zmq::send_flags::sndmore);
+            m_requests.send(to_message(spw_packet { entry.packet }, m_wire_format),
+                i + 1 < std::size(entries) ? zmq::send_flags::sndmore : zmq::send_flags::none);
         }
+        return;
     }
+    spdlog::error("Unsupported request {}", command);
+    m_requests.send(zmq::buffer(std::string_view { requests::error }), zmq::send_flags::none);
 }
 
 void ZMQServer::handle_requests()
@@ -130,8 +205,21 @@ void ZMQServer::handle_requests()
             if (m_requests.recv(message, zmq::recv_flags::dontwait))
             {
                 tries = 0;
-                m_requests.send(zmq::message_t { std::string { "ok" } }, zmq::send_flags::none);
-                SpaceWireBridges::send(to_packet(message));
+                if (message.more())
+                {
+                    std::vector<zmq::message_t> frames;
+                    frames.push_back(std::move(message));
+                    while (frames.back().more())
+                    {
+                        frames.emplace_back();
+                        (void)m_requests.recv(frames.back(), zmq::recv_flags::none);
+                    }
+                    handle_command(frames);
+                    continue;
+                }
+                m_requests.send(zmq::buffer(std::string_view { requests::ok }),
+                    zmq::send_flags::none);
+                SpaceWireBridges::send(take_packet(message, m_wire_format));
             }
             else
             {
@@ -21,25 +21,68 @@
 ----------------------------------------------------------------------------*/
 #pragma once
 #include "PacketQueue.hpp"
+#include "Recorder.hpp"
+#include "SpaceWireZMQ.hpp"
+#include "TopicHistory.hpp"
 #include "callable.hpp"
 #include "config/Config.hpp"
+#include <array>
 #include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
 #include <string_view>
 #include <thread>
+#include <vector>
 #include <zmq.hpp>
 
+/*
+ * Packets the PUB socket drops for subscribers past their high-water mark aren't counted here,
+ * ZMQ doesn't report them. They only show on the client side, as missed packets in
+ * ZMQClient::statistics() (see spw_packet::sequence).
+ */
+struct publisher_statistics
+{
+    uint64_t published = 0;
+    // published on the RAW topic since their protocol ID doesn't match any known topic
+    uint64_t unknown_protocol = 0;
+    // dropped since they are too short to carry a protocol ID
+    uint64_t malformed = 0;
+    // bridge events (see spw_event) published on the event socket
+    uint64_t events = 0;
+};
+
 class ZMQServer
 {
     zmq::context_t m_ctx;
     zmq::socket_t m_publisher;
     zmq::socket_t m_requests;
+    // only opened when some topics are routed to a multicast group
+    zmq::socket_t m_multicast;
+    // bridge events get their own socket and thread, they never wait behind packets
+    zmq::socket_t m_events;
+    endpoints::multicast::routes_t m_multicast_routes {};
     std::thread m_publisher_thread;
     std::thread m_req_thread;
+    std::thread m_event_thread;
     std::atomic<bool> m_running { true };
+    std::atomic<uint64_t> m_published { 0 };
+    std::atomic<uint64_t> m_unknown_protocol { 0 };
+    std::atomic<uint64_t> m_malformed { 0 };
+    std::atomic<uint64_t> m_events_published { 0 };
     Config m_cfg;
+    topics::protocol_table_t m_protocols;
+    wire_format_t m_wire_format = wire_format_t::serialized;
+    // only created when the configuration has a "recorder" section
+    std::unique_ptr<Recorder> m_recorder;
+    // only created when the configuration has a "history" section
+    std::unique_ptr<TopicHistory> m_history;
+    // last sequence number published on each topic type
+    std::array<uint64_t, std::size(topics::strings::table)> m_sequences {};
 
 public:
     packet_queue received_packets;
+    event_queue received_events;
 
     bool start();
     void loop();
@@ -47,11 +90,44 @@ public:
 
     inline Config configuration() { return m_cfg; }
 
-    ZMQServer(const Config& cfg) : m_cfg { cfg }
+    /*
+     * With the inproc transport, clients must be created with this context to reach the
+     * server and must be destroyed before it.
+     */
+    inline zmq::context_t& context() { return m_ctx; }
+
+    inline publisher_statistics statistics() const
+    {
+        return { m_published.load(), m_unknown_protocol.load(), m_malformed.load(),
+            m_events_published.load() };
+    }
+
+    inline std::optional<recorder_statistics> recording_statistics() const
+    {
+        if (m_recorder)
+            return m_recorder->statistics();
+        return std::nullopt;
+    }
+
+    ZMQServer(const Config& cfg)
+            : m_cfg { cfg }, m_protocols { topics::load_protocol_table(m_cfg["topics"]) }
     {
-        m_ctx = zmq::context_t { 1 };
+        // more I/O threads help when traffic is split across several interfaces
+        m_ctx = zmq::context_t { m_cfg["io_threads"].to<int>(1) };
         m_publisher = zmq::socket_t { m_ctx, zmq::socket_type::pub };
         m_requests = zmq::socket_t { m_ctx, zmq::socket_type::rep };
+        m_events = zmq::socket_t { m_ctx, zmq::socket_type::pub };
+        /*
+         * Messages queued per subscriber, once a slow subscriber reaches it ZMQ drops its
+         * messages instead of slowing down the others.
+         */
+        m_publisher.set(zmq::sockopt::sndhwm, m_cfg["pub_sndhwm"].to<int>(1000));
+        m_requests.set(zmq::sockopt::rcvhwm, m_cfg["req_rcvhwm"].to<int>(1000));
+        m_events.set(zmq::sockopt::sndhwm, m_cfg["pub_sndhwm"].to<int>(1000));
+        if (Recorder::enabled(m_cfg["recorder"]))
+            m_recorder = std::make_unique<Recorder>(m_cfg["recorder"]);
+        if (TopicHistory::enabled(m_cfg["history"]))
+            m_history = std::make_unique<TopicHistory>(m_cfg["history"]);
         start();
     }
 
@@ -60,5 +136,9 @@ public:
 private:
     void publish_packets();
 
+    void publish_events();
+
     void handle_requests();
+
+    void handle_command(std::vector<zmq::message_t>& frames);
 };
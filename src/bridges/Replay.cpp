@@ -0,0 +1,167 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#include "Replay.hpp"
+#include "CaptureFile.hpp"
+#include "PacketQueue.hpp"
+#include "SpaceWireBridges.hpp"
+#include "config/Config.hpp"
+#include <algorithm>
+#include <spdlog/spdlog.h>
+#include <sys/mman.h>
+
+static auto t = SpaceWireBridges::register_ctor(
+    "Replay", [](const std::string& name, const Config& cfg, packet_queue* publish_queue) {
+        return std::make_unique<SpaceWireBridge>(
+            std::make_unique<ReplayBridge>(cfg), publish_queue, name);
+    });
+
+void ReplayBridge::restart()
+{
+    m_position = m_first_position;
+    m_next.reset();
+    if (load_next())
+    {
+        m_first_timestamp_ns = m_next->timestamp_ns();
+        m_start = clock::now();
+    }
+}
+
+bool ReplayBridge::load_next()
+{
+    if (!m_capture)
+        return false;
+    m_next = m_capture->read(m_position);
+    // starts reading the following segment ahead once the current one is started
+    if (m_next && m_position.index == 1)
+    {
+        const auto& segments = m_capture->segments();
+        if (m_position.segment + 1 < std::size(segments))
+            segments[m_position.segment + 1].advise(MADV_WILLNEED);
+    }
+    return m_next.has_value();
+}
+
+void ReplayBridge::report(clock::time_point now, bool done)
+{
+    if (!done && now - m_last_report < m_report_period)
+        return;
+    const std::chrono::duration<double> elapsed = now - m_last_report;
+    if (elapsed.count() > 0.)
+        spdlog::info("Replay: {:.0f} packets/s, {:.2f} MB/s, {} packets replayed{}",
+            (m_packets - m_reported_packets) / elapsed.count(),
+            (m_bytes - m_reported_bytes) / elapsed.count() / 1e6, m_packets,
+            done ? ", done" : "");
+    m_last_report = now;
+    m_reported_packets = m_packets;
+    m_reported_bytes = m_bytes;
+}
+
+bool ReplayBridge::send_packet(const spw_packet& packet)
+{
+    spdlog::debug("Replay: dropping a {} bytes packet sent to port {}", packet.size(),
+        packet.port);
+    return false;
+}
+
+spw_packet ReplayBridge::receive_packet()
+{
+    if (!m_next)
+        return {};
+    auto packet = m_next->to_packet();
+    // SpaceWireBridge tags packets without bridge_id with this bridge instance name
+    if (!m_keep_bridge_id)
+        packet.bridge_id.clear();
+    m_packets++;
+    m_bytes += packet.size();
+    if (!load_next())
+    {
+        report(clock::now(), true);
+        if (m_loop)
+            restart();
+    }
+    else
+    {
+        report(clock::now(), false);
+    }
+    return packet;
+}
+
+// the next packet is due once the recorded delay since the first one, divided by the speed,
+// elapsed
+bool ReplayBridge::packet_received()
+{
+    if (!m_next)
+        return false;
+    if (m_speed <= 0.)
+        return true;
+    // system_clock may have stepped back while recording, such packets are due at once
+    const auto recorded_delay = static_cast<double>(std::max<int64_t>(
+        static_cast<int64_t>(m_next->timestamp_ns() - m_first_timestamp_ns), 0));
+    const auto due = m_start
+        + std::chrono::duration_cast<clock::duration>(
+            std::chrono::duration<double, std::nano> { recorded_delay / m_speed });
+    return clock::now() >= due;
+}
+
+bool ReplayBridge::configure(const Config& cfg)
+{
+    m_cfg = cfg;
+    const auto path = m_cfg["path"].to<std::string>("");
+    m_speed = to_double(m_cfg["speed"], 1.);
+    m_loop = m_cfg["loop"].to<bool>(false);
+    m_keep_bridge_id = m_cfg["keep_bridge_id"].to<bool>(false);
+    m_report_period = std::chrono::seconds { std::max(m_cfg["report_seconds"].to<int>(5), 1) };
+
+    m_capture = std::make_unique<CaptureFile>(path);
+    if (std::size(*m_capture) == 0)
+    {
+        spdlog::error("Replay: no packet found in {}", path);
+        m_capture.reset();
+        m_next.reset();
+        return false;
+    }
+    for (const auto& segment : m_capture->segments())
+        segment.advise(MADV_SEQUENTIAL);
+    m_first_position = m_capture->seek_sequence(
+        static_cast<uint64_t>(std::max(m_cfg["from_sequence"].to<int>(0), 0)));
+    spdlog::info("Replay: {} packets from {} at {}", std::size(*m_capture), path,
+        m_speed > 0. ? fmt::format("x{}", m_speed) : std::string { "full speed" });
+    m_last_report = clock::now();
+    restart();
+    return true;
+}
+
+bool ReplayBridge::set_configuration(const Config&)
+{
+    spdlog::error("Replay: the configuration can't change while the bridge runs, recreate it");
+    return false;
+}
+
+Config ReplayBridge::configuration() const
+{
+    return m_cfg;
+}
+
+ReplayBridge::ReplayBridge(const Config& cfg)
+{
+    configure(cfg);
+}
@@ -0,0 +1,83 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "CaptureFile.hpp"
+#include "SpaceWireBridge.hpp"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+/*
+ * Publishes recorded captures (see CaptureFile.hpp) as if they were received from hardware:
+ *   Replay:
+ *     path: /data/captures     # capture directory or a single segment
+ *     speed: 1.0               # multiplies the recorded timing, 0 replays as fast as possible
+ *     from_sequence: 0         # first packet to replay
+ *     loop: false              # starts again from from_sequence once done
+ *     keep_bridge_id: false    # packets are tagged with the bridge name unless set
+ *     report_seconds: 5        # achieved throughput log period
+ * As fast as possible replay is only limited by the publish queue, it makes a hardware free
+ * load generator for the server. Packets sent to this bridge are dropped.
+ * The receiving thread reads packets straight from the mapped capture, so the configuration
+ * can't be changed once the bridge is created.
+ */
+class ReplayBridge : public ISpaceWireBridge
+{
+    using clock = std::chrono::steady_clock;
+
+    Config m_cfg;
+    std::unique_ptr<CaptureFile> m_capture;
+    CaptureFile::position m_position;
+    CaptureFile::position m_first_position;
+    std::optional<capture::packet_view> m_next;
+    double m_speed = 1.;
+    bool m_loop = false;
+    bool m_keep_bridge_id = false;
+    std::chrono::seconds m_report_period { 5 };
+
+    // recorded time of the first replayed packet and when it was replayed
+    uint64_t m_first_timestamp_ns = 0;
+    clock::time_point m_start;
+
+    clock::time_point m_last_report;
+    uint64_t m_packets = 0;
+    uint64_t m_bytes = 0;
+    uint64_t m_reported_packets = 0;
+    uint64_t m_reported_bytes = 0;
+
+    bool configure(const Config& cfg);
+    void restart();
+    bool load_next();
+    void report(clock::time_point now, bool done);
+
+public:
+    virtual bool send_packet(const spw_packet& packet) final;
+    virtual spw_packet receive_packet() final;
+
+    virtual bool packet_received() final;
+    virtual bool set_configuration(const Config& cfg) final;
+    virtual Config configuration() const final;
+    ReplayBridge(const Config& cfg);
+    virtual ~ReplayBridge() = default;
+};
@@ -20,19 +20,22 @@
 --                     Mail : alexis.jeandet@lpp.polytechnique.fr
 ----------------------------------------------------------------------------*/
 #pragma once
+#include "SPSCRing.hpp"
 #include <algorithm>
-#include <callable.hpp>
 #include <cassert>
 #include <cfg_api_brick_mk2.h>
 #include <cfg_api_brick_mk3.h>
+#include <cfg_api_generic.h>
 #include <chrono>
-#include <list>
-#include <mutex>
+#include <cstdint>
+#include <functional>
+#include <limits>
 #include <optional>
 #include <star-api.h>
 #include <string>
 #include <strings/algorithms.hpp>
 #include <thread>
+#include <vector>
 
 namespace StarAPI
 {
@@ -67,6 +70,15 @@ struct ManagedRawPacketBuffer : RawPacketBuffer
         return *this;
     }
 
+    // the caller becomes responsible for releasing the data with STAR_destroyPacketData
+    unsigned char* release()
+    {
+        auto released = data;
+        data = nullptr;
+        size = 0UL;
+        return released;
+    }
+
     ~ManagedRawPacketBuffer()
     {
         if (data)
@@ -74,22 +86,82 @@ struct ManagedRawPacketBuffer : RawPacketBuffer
     }
 };
 
+// empty serial_number selects the first device found
 inline std::optional<STAR_DEVICE_ID> find_device(const std::string& serial_number)
 {
     std::optional<STAR_DEVICE_ID> maybe_dev { std::nullopt };
-    unsigned int dev_count;
+    unsigned int dev_count = 0;
     auto dev_list = STAR_getDeviceList(&dev_count);
+    if (!dev_list)
+        return maybe_dev;
     std::for_each(dev_list, dev_list + dev_count, [&maybe_dev, &serial_number](STAR_DEVICE_ID dev) {
+        if (maybe_dev)
+            return;
         auto SN = STAR_getDeviceSerialNumber(dev);
-        if (serial_number == cpp_utils::strings::trim(std::string { SN }))
+        if (std::empty(serial_number)
+            || (SN && serial_number == cpp_utils::strings::trim(std::string { SN })))
         {
             maybe_dev = dev;
         }
-        STAR_destroyString(SN);
+        if (SN)
+            STAR_destroyString(SN);
     });
+    STAR_destroyDeviceList(dev_list);
     return maybe_dev;
 }
 
+/*
+ * Brick MK2/MK3 links are clocked at base_transmit_clock * multiplier / divisor, this picks the
+ * clock setting closest to the requested link speed (in bit/s).
+ */
+namespace transmit_clock
+{
+    static constexpr unsigned int base_transmit_clock = 200000000;
+    static constexpr unsigned int min_speed = 2000000;
+    static constexpr unsigned int max_speed = 400000000;
+    static constexpr unsigned int max_multiplier = 2;
+    static constexpr unsigned int max_divisor = 100;
+
+    inline unsigned int speed(const STAR_CFG_MK2_BASE_TRANSMIT_CLOCK& clock)
+    {
+        return static_cast<unsigned int>(
+            uint64_t { base_transmit_clock } * clock.multiplier / clock.divisor);
+    }
+
+    inline STAR_CFG_MK2_BASE_TRANSMIT_CLOCK from_speed(unsigned int speed)
+    {
+        STAR_CFG_MK2_BASE_TRANSMIT_CLOCK best { 1, 1 };
+        uint64_t best_error = std::numeric_limits<uint64_t>::max();
+        for (unsigned int multiplier = 1; multiplier <= max_multiplier; multiplier++)
+        {
+            for (unsigned int divisor = 1; divisor <= max_divisor; divisor++)
+            {
+                const STAR_CFG_MK2_BASE_TRANSMIT_CLOCK clock { multiplier, divisor };
+                const auto actual = transmit_clock::speed(clock);
+                const uint64_t error = actual > speed ? actual - speed : speed - actual;
+                if (actual >= min_speed && actual <= max_speed && error < best_error)
+                {
+                    best = clock;
+                    best_error = error;
+                }
+            }
+        }
+        return best;
+    }
+}
+
+struct link_status
+{
+    bool running = false;
+    struct
+    {
+        uint32_t parity = 0;
+        uint32_t disconnect = 0;
+        uint32_t credit = 0;
+        uint32_t escape = 0;
+    } errors;
+};
+
 class Device
 {
     std::optional<STAR_DEVICE_ID> m_handle { std::nullopt };
@@ -98,19 +170,57 @@ public:
     inline auto handle() const { return m_handle.value(); }
     inline bool ready() const { return bool(m_handle); }
 
-    bool set_speed(unsigned int speed, std::size_t port)
+    inline std::string serial_number() const
+    {
+        std::string serial;
+        if (ready())
+        {
+            if (auto SN = STAR_getDeviceSerialNumber(handle()))
+            {
+                serial = cpp_utils::strings::trim(std::string { SN });
+                STAR_destroyString(SN);
+            }
+        }
+        return serial;
+    }
+
+    // returns the link speed actually set (in bit/s) or nullopt if the device can't do it
+    std::optional<unsigned int> set_speed(unsigned int speed, std::size_t port)
     {
-        if ((2000000 <= speed) && (400000000 >= speed))
+        if ((transmit_clock::min_speed <= speed) && (transmit_clock::max_speed >= speed)
+            && ready())
         {
-            if (ready())
+            const auto clock = transmit_clock::from_speed(speed);
+            const auto link = static_cast<unsigned char>(port);
+            bool done = false;
+            switch (STAR_getDeviceType(handle()))
             {
-                //@TODO!
-                CFG_BRICK_MK3_setTransmitClock(
-                    handle(), port, STAR_CFG_MK2_BASE_TRANSMIT_CLOCK { 2, 40 });
-                return true;
+                case STAR_DEVICE_BRICK_MK2:
+                    done = CFG_BRICK_MK2_setTransmitClock(handle(), link, clock);
+                    break;
+                case STAR_DEVICE_BRICK_MK3:
+                    done = CFG_BRICK_MK3_setTransmitClock(handle(), link, clock);
+                    break;
+                default:
+                    break;
             }
+            if (done)
+                return transmit_clock::speed(clock);
         }
-        return false;
+        return std::nullopt;
+    }
+
+    // link state and error counters through the generic configuration API
+    std::optional<link_status> get_link_status(std::size_t port) const
+    {
+        STAR_CFG_SPW_LINK_STATUS status {};
+        if (ready() && CFG_SPW_LINK_getStatus(handle(), static_cast<unsigned char>(port), &status))
+        {
+            return link_status { status.isRunning != 0,
+                { status.parityErrorCount, status.disconnectErrorCount, status.creditErrorCount,
+                    status.escapeErrorCount } };
+        }
+        return std::nullopt;
     }
 
     Device() = default;
@@ -133,52 +243,107 @@ template <channel_direction_t dir>
 inline constexpr bool is_output
     = (dir == channel_direction_t::out) or (dir == channel_direction_t::inout);
 
+/*
+ * Receive side tuning, each rx operation completes once it got packets_per_operation packets
+ * (so more than one trades latency for throughput) and operations rx operations are kept
+ * submitted so the driver always has a pending receive while a completed one is being drained.
+ */
+struct rx_options
+{
+    unsigned int operations = 3;
+    unsigned int packets_per_operation = 1;
+    // called from the STAR-API completion thread for each received time-code
+    std::function<void(unsigned char)> on_time_code;
+};
+
 template <channel_direction_t direction_>
 class Channel
 {
     std::optional<STAR_CHANNEL_ID> m_handle { std::nullopt };
-    std::list<ManagedRawPacketBuffer> m_received_packets;
-    std::mutex m_packet_queue_mutex;
-    STAR_TRANSFER_OPERATION* m_rx_operation;
+    // filled by the STAR-API completion thread and drained by the bridge receiving thread
+    SPSCRing<ManagedRawPacketBuffer, 4096> m_received_packets;
+    std::vector<STAR_TRANSFER_OPERATION*> m_rx_operations;
+    std::function<void(unsigned char)> m_on_time_code;
+
+    static void rx_completed(
+        STAR_TRANSFER_OPERATION* pOperation, STAR_TRANSFER_STATUS status, void* pContextInfo)
+    {
+        static_cast<Channel*>(pContextInfo)->drain_rx_operation(pOperation, status);
+    }
+
+    void drain_rx_operation(STAR_TRANSFER_OPERATION* pOperation, STAR_TRANSFER_STATUS status)
+    {
+        if (status == STAR_TRANSFER_STATUS_COMPLETE)
+        {
+            const auto count = STAR_getTransferItemCount(pOperation);
+            for (auto index = 0U; index < count; index++)
+            {
+                auto streamItem = STAR_getTransferItem(pOperation, index);
+                if (streamItem && streamItem->itemType == STAR_STREAM_ITEM_TYPE_SPACEWIRE_PACKET)
+                {
+                    unsigned int dataLength = 0;
+                    unsigned char* data = STAR_getPacketData(
+                        (STAR_SPACEWIRE_PACKET*)streamItem->item, &dataLength);
+                    m_received_packets.push(ManagedRawPacketBuffer { data, dataLength });
+                }
+                else if (streamItem && streamItem->itemType == STAR_STREAM_ITEM_TYPE_TIMECODE
+                    && m_on_time_code)
+                {
+                    // time-code items carry the received time-code byte
+                    m_on_time_code(*static_cast<unsigned char*>(streamItem->item));
+                }
+                if (streamItem)
+                    STAR_destroyStreamItem(streamItem);
+            }
+        }
+        // the other operations are still pending while this one gets resubmitted
+        if (status != STAR_TRANSFER_STATUS_CANCELLED)
+            STAR_submitTransferOperation(*m_handle, pOperation);
+    }
 
-    void register_rx_callback()
+    void register_rx_callback(const rx_options& options)
     {
         static_assert(is_input<direction>,
             "Registering reception callback on output only channel is an error!");
-        m_rx_operation = STAR_createRxOperation(1, STAR_RECEIVE_PACKETS);
-        if (m_rx_operation)
+        for (auto i = 0U; i < std::max(options.operations, 1U); i++)
+        {
+            auto operation = STAR_createRxOperation(
+                std::max(options.packets_per_operation, 1U), STAR_RECEIVE_PACKETS);
+            if (operation)
+            {
+                STAR_registerTransferCompletionListener(operation, &Channel::rx_completed, this);
+                m_rx_operations.push_back(operation);
+            }
+        }
+        // a dedicated operation so time-codes never wait for packets to fill a batch
+        m_on_time_code = options.on_time_code;
+        if (m_on_time_code)
         {
-            STAR_registerTransferCompletionListener(m_rx_operation,
-                callableToPointer([this](STAR_TRANSFER_OPERATION* pOperation,
-                                      STAR_TRANSFER_STATUS status, void* pContextInfo) {
-                    if (status == STAR_TRANSFER_STATUS_COMPLETE)
-                    {
-                        std::lock_guard guard { m_packet_queue_mutex };
-                        auto streamItem = STAR_getTransferItem(pOperation, 0);
-                        unsigned int dataLength = 0;
-                        unsigned char* data = STAR_getPacketData(
-                            (STAR_SPACEWIRE_PACKET*)streamItem->item, &dataLength);
-                        m_received_packets.push_front(ManagedRawPacketBuffer { data, dataLength });
-                        STAR_destroyStreamItem(streamItem);
-                    }
-                    STAR_submitTransferOperation(*m_handle, m_rx_operation);
-                }),
-                nullptr);
-            STAR_submitTransferOperation(*m_handle, m_rx_operation);
+            if (auto operation = STAR_createRxOperation(1, STAR_RECEIVE_TIMECODES))
+            {
+                STAR_registerTransferCompletionListener(operation, &Channel::rx_completed, this);
+                m_rx_operations.push_back(operation);
+            }
         }
+        for (auto operation : m_rx_operations)
+            STAR_submitTransferOperation(*m_handle, operation);
     }
 
     inline void dispose_rx_callback()
     {
         static_assert(is_input<direction>,
             "Registering reception callback on output only channel is an error!");
-        STAR_disposeTransferOperation(m_rx_operation);
+        for (auto operation : m_rx_operations)
+            STAR_cancelTransferOperation(operation);
+        for (auto operation : m_rx_operations)
+            STAR_disposeTransferOperation(operation);
+        m_rx_operations.clear();
     }
 
 public:
     static constexpr auto direction = direction_;
 
-    void open(const Device& dev, unsigned int dev_channel)
+    void open(const Device& dev, unsigned int dev_channel, const rx_options& options = {})
     {
         if (dev.ready())
         {
@@ -186,18 +351,17 @@ public:
                 dev.handle(), static_cast<STAR_CHANNEL_DIRECTION>(direction), dev_channel, 1);
             if constexpr (is_input<direction>)
             {
-                register_rx_callback();
+                register_rx_callback(options);
             }
         }
     }
 
     inline bool ready() const { return bool(m_handle); }
 
-    inline std::size_t available_packets_count()
-    {
-        std::lock_guard lock { m_packet_queue_mutex };
-        return std::size(m_received_packets);
-    }
+    inline std::size_t available_packets_count() const { return m_received_packets.size(); }
+
+    // packets dropped because the bridge receiving thread did not keep up
+    inline uint64_t overflows() const { return m_received_packets.overflows(); }
 
     template <channel_direction_t d = direction_>
     inline typename std::enable_if_t<is_output<d>, void> send_packet(const RawPacketBuffer& buffer)
@@ -212,20 +376,20 @@ public:
         using namespace std::chrono_literals;
         while (1)
         {
-            {
-                std::lock_guard lock(m_packet_queue_mutex);
-                if (std::size(m_received_packets))
-                {
-                    ManagedRawPacketBuffer p { std::move(m_received_packets.back()) };
-                    m_received_packets.pop_back();
-                    return p;
-                }
-            }
+            if (auto p = m_received_packets.pop())
+                return std::move(*p);
             // to avoid this, only call receive packet when packet queue isn't empty
             std::this_thread::sleep_for(100us);
         }
     }
 
+    template <channel_direction_t d = direction_>
+    inline typename std::enable_if_t<is_input<d>, std::optional<ManagedRawPacketBuffer>>
+    try_receive_packet()
+    {
+        return m_received_packets.pop();
+    }
+
     template <channel_direction_t d = direction_>
     typename std::enable_if_t<is_output<d>, Channel&> operator>>(const RawPacketBuffer& buffer)
     {
@@ -242,7 +406,10 @@ public:
 
 
     Channel() = default;
-    Channel(const Device& dev, unsigned int dev_channel) { open(dev, dev_channel); }
+    Channel(const Device& dev, unsigned int dev_channel, const rx_options& options = {})
+    {
+        open(dev, dev_channel, options);
+    }
     Channel(Channel&& other)
     {
         if (other.m_handle)
@@ -250,6 +417,10 @@ public:
     }
     ~Channel()
     {
+        if constexpr (is_input<direction>)
+        {
+            dispose_rx_callback();
+        }
         if (m_handle)
             STAR_closeChannel(*m_handle);
     }
@@ -20,23 +20,29 @@
 --                     Mail : alexis.jeandet@lpp.polytechnique.fr
 ----------------------------------------------------------------------------*/
 #include "StarDundee.hpp"
+#include "BridgePluginAdapter.hpp"
 #include "PacketQueue.hpp"
-#include "SpaceWireBridges.hpp"
 #include "StarAPI.hpp"
 #include "config/Config.hpp"
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <spdlog/spdlog.h>
 #include <star-api.h>
 
 
-static auto t = SpaceWireBridges::register_ctor(
-    "STAR-Dundee", [](const Config& cfg, packet_queue* publish_queue) {
-        return std::make_unique<SpaceWireBridge>(
-            std::make_unique<STARDundeeBridge>(cfg), publish_queue);
-    });
+// built as a plugin so the server binary doesn't depend on STAR-System (see BridgePlugins.hpp)
+static const auto plugin = bridge_plugin_adapter<STARDundeeBridge>::plugin("STAR-Dundee");
+
+extern "C" const spw_bridge_plugin* spacewirezmq_bridge_plugin(void)
+{
+    return &plugin;
+}
 
 
 bool STARDundeeBridge::send_packet(const spw_packet& packet)
 {
-    if (m_setup && packet.port < std::size(m_channels))
+    if (m_setup && packet.port < std::size(m_channels) && m_channels[packet.port].ready())
     {
         m_channels[packet.port].send_packet(
             { (unsigned char*)packet.data.data(), std::size(packet.data) });
@@ -48,43 +54,214 @@ bool STARDundeeBridge::send_packet(const spw_packet& packet)
 spw_packet STARDundeeBridge::receive_packet()
 {
     spw_packet packet;
-    if (m_setup && packet.port < std::size(m_channels))
+    const auto count = std::size(m_channels);
+    for (auto i = 0UL; m_ready_ports && i < count; i++)
     {
-        auto buffer = m_channels[packet.port].receive_packet();
-        packet.data.resize(buffer.size);
-        std::memcpy(packet.data.data(),buffer.data, buffer.size);
+        const auto port = (m_next_port + i) % count;
+        if (m_ready_ports & (uint64_t { 1 } << port))
+        {
+            m_ready_ports &= ~(uint64_t { 1 } << port);
+            if (auto buffer = m_channels[port].try_receive_packet())
+            {
+                const auto size = buffer->size;
+                packet.data = packet_buffer::adopt(buffer->release(), size,
+                    [](unsigned char* data) { STAR_destroyPacketData(data); });
+                packet.port = port;
+                m_next_port = port + 1;
+                break;
+            }
+        }
     }
     return packet;
 }
 
 bool STARDundeeBridge::packet_received()
 {
-    return std::accumulate(std::begin(m_channels), std::end(m_channels),0,[](int value,auto & chan)
+    if (!m_setup)
+        return false;
+    m_ready_ports = 0;
+    for (auto port = 0UL; port < std::size(m_channels); port++)
+    {
+        if (m_channels[port].available_packets_count())
+            m_ready_ports |= uint64_t { 1 } << port;
+    }
+    return m_ready_ports != 0;
+}
+
+namespace
+{
+// YAML reads numeric serial numbers as integers
+std::string serial_number(Config cfg)
+{
+    if (const auto serial = cfg.to<int>(-1); serial >= 0)
+        return std::to_string(serial);
+    return cfg.to<std::string>("");
+}
+
+unsigned int rx_setting(Config cfg, int default_value)
+{
+    return static_cast<unsigned int>(std::max(cfg.to<int>(default_value), 1));
+}
+}
+
+void STARDundeeBridge::apply_link_speeds()
+{
+    for (const auto& port : m_ports)
     {
-        return value+chan.available_packets_count();
-    });
+        // left by gaps in the configured port numbers
+        if (port.link == 0)
+            continue;
+        const auto requested = static_cast<unsigned int>(port.speed * 1e6);
+        if (auto actual = m_device.set_speed(requested, port.link))
+            spdlog::info("STAR-Dundee {}: link {} running at {:.2f} Mbit/s",
+                m_device.serial_number(), port.link, *actual / 1e6);
+        else
+            spdlog::error("STAR-Dundee {}: can't set link {} speed to {} Mbit/s",
+                m_device.serial_number(), port.link, port.speed);
+    }
 }
 
 bool STARDundeeBridge::set_configuration(const Config& cfg)
 {
+    // the status thread reads the ports
+    std::lock_guard lock { m_status_mutex };
+    m_cfg = cfg;
+    const auto default_speed = to_double(m_cfg["speed"], 10.);
+    m_ports.clear();
+    if (auto ports = m_cfg["ports"]; !ports.isEmpty())
+    {
+        for (const auto& [name, node] : ports)
+        {
+            if (std::empty(name) || !std::all_of(std::cbegin(name), std::cend(name), ::isdigit))
+            {
+                spdlog::error("STAR-Dundee: port {} isn't a number, ignoring it.", name);
+                continue;
+            }
+            if (std::size(name) > 2 || std::stoul(name) >= max_ports)
+            {
+                spdlog::error("STAR-Dundee: port {} out of range, ignoring it.", name);
+                continue;
+            }
+            const auto index = static_cast<std::size_t>(std::stoul(name));
+            m_ports.resize(std::max(std::size(m_ports), index + 1), port_t { 0U, 0. });
+            m_ports[index] = port_t { static_cast<unsigned int>((*node)["link"].to<int>(0)),
+                to_double((*node)["speed"], default_speed) };
+        }
+    }
+    else
+    {
+        m_ports = { { 1U, default_speed }, { 2U, default_speed } };
+    }
+    if (m_setup)
+        apply_link_speeds();
     return true;
 }
 
 Config STARDundeeBridge::configuration() const
 {
-    return {};
+    return m_cfg;
 }
 
 STARDundeeBridge::STARDundeeBridge(const Config& cfg)
 {
     using namespace StarAPI;
-    m_device = Device { "30170316" };
-    m_device.set_speed(10000000,1);
-    m_device.set_speed(10000000,2);
-    m_channels.resize(2);
-    m_channels[0].open(m_device, 1 );
-    m_channels[1].open(m_device, 2 );
+    set_configuration(cfg);
+    const auto serial = serial_number(m_cfg["serial"]);
+    m_device = Device { serial };
+    if (!m_device.ready())
+    {
+        if (std::empty(serial))
+            spdlog::error("STAR-Dundee: no device found");
+        else
+            spdlog::error("STAR-Dundee: device {} not found", serial);
+        return;
+    }
+    rx_options rx;
+    rx.operations = rx_setting(m_cfg["rx_operations"], 3);
+    rx.packets_per_operation = rx_setting(m_cfg["rx_packets_per_operation"], 1);
+    const bool time_codes = m_cfg["time_codes"].to<bool>(true);
+    m_channels.resize(std::size(m_ports));
+    for (auto index = 0UL; index < std::size(m_ports); index++)
+    {
+        // runs on the STAR-API completion thread, publish_event drops rather than waits there
+        if (time_codes)
+            rx.on_time_code = [this, index](unsigned char time_code) {
+                spw_event event;
+                event.kind = spw_event::kind_t::time_code;
+                event.port = index;
+                event.time_code = time_code;
+                publish_event(std::move(event));
+            };
+        if (m_ports[index].link)
+            m_channels[index].open(m_device, m_ports[index].link, rx);
+    }
     m_setup = true;
+    apply_link_speeds();
+    if (const auto period = m_cfg["status_period_ms"].to<int>(100); period > 0)
+        m_status_thread = std::thread(
+            &STARDundeeBridge::status_thread, this, std::chrono::milliseconds { period });
+}
+
+void STARDundeeBridge::status_thread(std::chrono::milliseconds period)
+{
+    const auto error_counters = [](const StarAPI::link_status& status) {
+        return spw_event::error_counters { status.errors.parity, status.errors.disconnect,
+            status.errors.credit, status.errors.escape };
+    };
+    std::vector<std::optional<StarAPI::link_status>> last(std::size(m_ports));
+    std::vector<spw_event> pending;
+    std::unique_lock lock { m_status_mutex };
+    while (!m_status_cv.wait_for(lock, period, [this]() { return m_stopping; }))
+    {
+        last.resize(std::size(m_ports));
+        for (auto index = 0UL; index < std::size(m_ports); index++)
+        {
+            if (!m_ports[index].link)
+                continue;
+            const auto status = m_device.get_link_status(m_ports[index].link);
+            if (!status)
+                continue;
+            spw_event event;
+            event.port = index;
+            event.errors = error_counters(*status);
+            if (!last[index] || last[index]->running != status->running)
+            {
+                event.kind = status->running ? spw_event::kind_t::link_up
+                                             : spw_event::kind_t::link_down;
+                pending.push_back(event);
+            }
+            if (last[index] && error_counters(*last[index]) != event.errors)
+            {
+                event.kind = spw_event::kind_t::errors;
+                pending.push_back(std::move(event));
+            }
+            last[index] = status;
+        }
+        // publishing may wait for space in the event queue, set_configuration() and the
+        // destructor must not wait behind it
+        lock.unlock();
+        for (auto& event : pending)
+            publish_event(std::move(event));
+        pending.clear();
+        lock.lock();
+    }
 }
 
-STARDundeeBridge::~STARDundeeBridge() { }
+STARDundeeBridge::~STARDundeeBridge()
+{
+    if (m_status_thread.joinable())
+    {
+        {
+            std::lock_guard lock { m_status_mutex };
+            m_stopping = true;
+        }
+        m_status_cv.notify_all();
+        m_status_thread.join();
+    }
+    for (auto index = 0UL; index < std::size(m_channels); index++)
+    {
+        if (const auto overflows = m_channels[index].overflows(); overflows)
+            spdlog::warn("STAR-Dundee: {} packets dropped on channel {}, receive queue full",
+                overflows, index);
+    }
+}
@@ -23,16 +23,55 @@
 #include "SpaceWireBridge.hpp"
 #include <star-api.h>
 #include "StarAPI.hpp"
-#include <queue>
+#include "config/Config.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
 
+/*
+ * STAR-Dundee brick bridge, spw_packet::port selects the device link:
+ *   STAR-Dundee:
+ *     serial: 30170316             # first device found when omitted
+ *     speed: 10                    # default link speed in Mbit/s
+ *     rx_operations: 3             # see StarAPI::rx_options
+ *     rx_packets_per_operation: 1
+ *     time_codes: true             # publishes received time-codes as events
+ *     status_period_ms: 100        # link status and error counters polling, 0 disables it
+ *     ports:                       # packet port: device link, links 1 and 2 when omitted
+ *       0: { link: 1, speed: 200 }
+ *       1: { link: 2 }
+ * Several bricks are served as named instances (STAR-Dundee-A, STAR-Dundee-B...), each one
+ * needs its serial.
+ */
 class STARDundeeBridge: public ISpaceWireBridge
 {
+    struct port_t
+    {
+        unsigned int link;
+        double speed; // Mbit/s
+    };
+    Config m_cfg;
     StarAPI::Device m_device;
+    std::vector<port_t> m_ports;
     std::vector<StarAPI::Channel<StarAPI::channel_direction_t::inout>> m_channels;
     bool m_setup{false};
-    std::queue<spw_packet> m_rx_packets;
+    // bit i set when channel i has packets, refreshed by packet_received
+    uint64_t m_ready_ports { 0 };
+    // round robin start so a busy port can't starve the others
+    std::size_t m_next_port { 0 };
+    static constexpr std::size_t max_ports = 64;
+    // polls link status and error counters, publishing changes as events
+    std::thread m_status_thread;
+    std::mutex m_status_mutex;
+    std::condition_variable m_status_cv;
+    bool m_stopping { false };
+
+    void apply_link_speeds();
+    void status_thread(std::chrono::milliseconds period);
 public:
-    void packet_receiver_callback(STAR_TRANSFER_OPERATION *pOperation, STAR_TRANSFER_STATUS status);
     virtual bool send_packet(const spw_packet& packet)final;
     virtual spw_packet receive_packet()final;
 
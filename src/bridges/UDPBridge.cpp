@@ -0,0 +1,279 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#include "UDPBridge.hpp"
+#include "PacketQueue.hpp"
+#include "SpaceWireBridges.hpp"
+#include "config/Config.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <netdb.h>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <unistd.h>
+
+static auto t = SpaceWireBridges::register_ctor(
+    "UDP", [](const std::string& name, const Config& cfg, packet_queue* publish_queue) {
+        return std::make_unique<SpaceWireBridge>(
+            std::make_unique<UDPBridge>(cfg), publish_queue, name);
+    });
+
+namespace
+{
+struct udp_address
+{
+    sockaddr_storage address {};
+    socklen_t length = 0;
+};
+
+// resolves "host:port", the port is taken after the last colon
+std::optional<udp_address> resolve(const std::string& host_port, bool passive)
+{
+    const auto colon = host_port.rfind(':');
+    if (colon == std::string::npos)
+    {
+        spdlog::error("UDP: expected host:port, got \"{}\"", host_port);
+        return std::nullopt;
+    }
+    const auto host = host_port.substr(0, colon);
+    const auto port = host_port.substr(colon + 1);
+    addrinfo hints {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags = passive ? AI_PASSIVE : 0;
+    addrinfo* result = nullptr;
+    if (const auto rc = getaddrinfo(
+            std::empty(host) ? nullptr : host.c_str(), port.c_str(), &hints, &result);
+        rc != 0)
+    {
+        spdlog::error("UDP: can't resolve {}: {}", host_port, gai_strerror(rc));
+        return std::nullopt;
+    }
+    udp_address resolved;
+    std::memcpy(&resolved.address, result->ai_addr, result->ai_addrlen);
+    resolved.length = result->ai_addrlen;
+    freeaddrinfo(result);
+    return resolved;
+}
+}
+
+void UDPBridge::close_socket()
+{
+    if (m_socket >= 0)
+        ::close(m_socket);
+    m_socket = -1;
+    m_rx_count = m_rx_next = 0;
+}
+
+bool UDPBridge::valid_datagram(const mmsghdr& msg) const
+{
+    const auto* header = static_cast<const unsigned char*>(msg.msg_hdr.msg_iov->iov_base);
+    return !(msg.msg_hdr.msg_flags & MSG_TRUNC) && msg.msg_len >= header_size
+        && header[0] == 'S' && header[1] == 'W' && header[3] == header_version;
+}
+
+bool UDPBridge::receive_batch()
+{
+    m_rx_count = m_rx_next = 0;
+    if (m_socket < 0)
+        return false;
+    for (auto& msg : m_rx_msgs)
+        msg.msg_hdr.msg_flags = 0;
+    const auto received = recvmmsg(
+        m_socket, m_rx_msgs.data(), std::size(m_rx_msgs), MSG_DONTWAIT, nullptr);
+    if (received < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            spdlog::error("UDP: recvmmsg failed: {}", std::strerror(errno));
+        return false;
+    }
+    m_rx_count = static_cast<std::size_t>(received);
+    return m_rx_count != 0;
+}
+
+bool UDPBridge::packet_received()
+{
+    while (true)
+    {
+        for (; m_rx_next < m_rx_count; m_rx_next++)
+        {
+            if (valid_datagram(m_rx_msgs[m_rx_next]))
+                return true;
+            if (++m_dropped % 1000 == 1)
+                spdlog::warn("UDP: dropped {} malformed or truncated datagrams", m_dropped);
+        }
+        if (!receive_batch())
+            return false;
+    }
+}
+
+spw_packet UDPBridge::receive_packet()
+{
+    const auto& msg = m_rx_msgs[m_rx_next];
+    const auto* slot = rx_slot(m_rx_next);
+    m_rx_next++;
+    spw_packet packet { msg.msg_len - header_size, slot[2], "" };
+    std::copy(slot + header_size, slot + msg.msg_len, packet.data.data());
+    return packet;
+}
+
+std::size_t UDPBridge::send_packets(const std::vector<spw_packet>& packets)
+{
+    if (m_socket < 0 || m_peer_len == 0)
+        return 0;
+    std::size_t sent = 0;
+    auto next = std::cbegin(packets);
+    while (next != std::cend(packets))
+    {
+        std::size_t count = 0;
+        for (; next != std::cend(packets) && count < std::size(m_tx_msgs); next++)
+        {
+            if (next->port > 0xFF || next->size() > m_max_packet_size)
+            {
+                spdlog::error("UDP: can't send a {} bytes packet to port {}", next->size(),
+                    next->port);
+                continue;
+            }
+            m_tx_headers[count] = { 'S', 'W', static_cast<unsigned char>(next->port),
+                header_version };
+            m_tx_iovecs[2 * count] = { m_tx_headers[count].data(), header_size };
+            m_tx_iovecs[2 * count + 1]
+                = { const_cast<unsigned char*>(next->data.data()), next->size() };
+            auto& hdr = m_tx_msgs[count].msg_hdr;
+            hdr = {};
+            hdr.msg_name = &m_peer;
+            hdr.msg_namelen = m_peer_len;
+            hdr.msg_iov = &m_tx_iovecs[2 * count];
+            hdr.msg_iovlen = 2;
+            count++;
+        }
+        // sendmmsg may stop early, it only fails when the first datagram can't be sent
+        std::size_t done = 0;
+        while (done < count)
+        {
+            const auto rc = sendmmsg(m_socket, m_tx_msgs.data() + done, count - done, 0);
+            if (rc < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                spdlog::error("UDP: sendmmsg failed: {}", std::strerror(errno));
+                done++;
+                continue;
+            }
+            done += static_cast<std::size_t>(rc);
+            sent += static_cast<std::size_t>(rc);
+        }
+    }
+    return sent;
+}
+
+bool UDPBridge::send_packet(const spw_packet& packet)
+{
+    return send_packets({ packet }) == 1;
+}
+
+bool UDPBridge::configure(const Config& cfg)
+{
+    m_cfg = cfg;
+    const auto batch = static_cast<std::size_t>(std::clamp(m_cfg["batch"].to<int>(64), 1, 1024));
+    m_max_packet_size = static_cast<std::size_t>(
+        std::clamp(m_cfg["max_packet_size"].to<int>(65503), 1, 65503));
+
+    m_rx_buffers.resize(batch * (header_size + m_max_packet_size));
+    m_rx_iovecs.resize(batch);
+    m_rx_msgs.resize(batch);
+    for (auto i = 0UL; i < batch; i++)
+    {
+        m_rx_iovecs[i] = { rx_slot(i), header_size + m_max_packet_size };
+        m_rx_msgs[i] = {};
+        m_rx_msgs[i].msg_hdr.msg_iov = &m_rx_iovecs[i];
+        m_rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    m_tx_msgs.resize(batch);
+    m_tx_iovecs.resize(2 * batch);
+    m_tx_headers.resize(batch);
+
+    const auto bind_address = resolve(m_cfg["bind"].to<std::string>("0.0.0.0:5500"), true);
+    if (!bind_address)
+        return false;
+    m_peer_len = 0;
+    if (const auto peer = m_cfg["peer"].to<std::string>(""); !std::empty(peer))
+    {
+        const auto peer_address = resolve(peer, false);
+        if (!peer_address)
+            return false;
+        m_peer = peer_address->address;
+        m_peer_len = peer_address->length;
+    }
+    else
+    {
+        spdlog::warn("UDP: no peer given, packets sent to this bridge will be dropped");
+    }
+
+    m_socket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (m_socket < 0)
+    {
+        spdlog::error("UDP: can't create socket: {}", std::strerror(errno));
+        return false;
+    }
+    const int rcvbuf = std::max(m_cfg["rcvbuf_mb"].to<int>(8), 1) * 1024 * 1024;
+    setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    int effective = 0;
+    socklen_t effective_len = sizeof(effective);
+    // the kernel doubles the requested size and caps it to net.core.rmem_max
+    if (getsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &effective, &effective_len) == 0
+        && effective < rcvbuf)
+        spdlog::warn("UDP: receive buffer limited to {} bytes, raise net.core.rmem_max", effective);
+    if (bind(m_socket, reinterpret_cast<const sockaddr*>(&bind_address->address),
+            bind_address->length)
+        != 0)
+    {
+        spdlog::error("UDP: can't bind {}: {}", m_cfg["bind"].to<std::string>("0.0.0.0:5500"),
+            std::strerror(errno));
+        close_socket();
+        return false;
+    }
+    spdlog::info("UDP: bound to {}, batches of {} datagrams",
+        m_cfg["bind"].to<std::string>("0.0.0.0:5500"), batch);
+    return true;
+}
+
+bool UDPBridge::set_configuration(const Config&)
+{
+    spdlog::error("UDP: the configuration can't change while the bridge runs, recreate it");
+    return false;
+}
+
+Config UDPBridge::configuration() const
+{
+    return m_cfg;
+}
+
+UDPBridge::UDPBridge(const Config& cfg)
+{
+    configure(cfg);
+}
+
+UDPBridge::~UDPBridge()
+{
+    close_socket();
+}
@@ -0,0 +1,89 @@
+/*------------------------------------------------------------------------------
+--  This file is a part of the SocExplorer Software
+--  Copyright (C) 2021, Plasma Physics Laboratory - CNRS
+--
+--  This program is free software; you can redistribute it and/or modify
+--  it under the terms of the GNU General Public License as published by
+--  the Free Software Foundation; either version 2 of the License, or
+--  (at your option) any later version.
+--
+--  This program is distributed in the hope that it will be useful,
+--  but WITHOUT ANY WARRANTY; without even the implied warranty of
+--  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+--  GNU General Public License for more details.
+--
+--  You should have received a copy of the GNU General Public License
+--  along with this program; if not, write to the Free Software
+--  Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+-------------------------------------------------------------------------------*/
+/*--                  Author : Alexis Jeandet
+--                     Mail : alexis.jeandet@lpp.polytechnique.fr
+----------------------------------------------------------------------------*/
+#pragma once
+#include "SpaceWireBridge.hpp"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <vector>
+
+/*
+ * Tunnels SpaceWire packets over UDP, one packet per datagram behind a 4 bytes header:
+ *   'S' 'W' <SpaceWire port> <header version>
+ *   UDP:
+ *     bind: 0.0.0.0:5500         # local address packets are received on
+ *     peer: 192.168.0.10:5500    # where packets sent to this bridge go
+ *     batch: 64                  # datagrams per recvmmsg/sendmmsg call
+ *     max_packet_size: 65503     # larger packets are dropped
+ *     rcvbuf_mb: 8               # kernel receive buffer, absorbs bursts between two polls
+ * Datagrams are received and sent by batches so the system call cost is shared by up to
+ * "batch" packets, two bridges bound on localhost and peered together make a loopback link.
+ * The socket and batch buffers are used by the bridge threads without locking, so the
+ * configuration can't be changed once the bridge is created.
+ */
+class UDPBridge : public ISpaceWireBridge
+{
+    static constexpr unsigned char header_version = 1;
+    static constexpr std::size_t header_size = 4;
+
+    Config m_cfg;
+    int m_socket = -1;
+    sockaddr_storage m_peer {};
+    socklen_t m_peer_len = 0;
+    std::size_t m_max_packet_size = 65503;
+
+    // receive batch, datagrams [m_rx_next, m_rx_count) are still to be handed over
+    std::vector<mmsghdr> m_rx_msgs;
+    std::vector<iovec> m_rx_iovecs;
+    std::vector<unsigned char> m_rx_buffers;
+    std::size_t m_rx_count = 0;
+    std::size_t m_rx_next = 0;
+
+    // send batch, two iovecs per packet: header then data
+    std::vector<mmsghdr> m_tx_msgs;
+    std::vector<iovec> m_tx_iovecs;
+    std::vector<std::array<unsigned char, header_size>> m_tx_headers;
+
+    uint64_t m_dropped = 0;
+
+    bool configure(const Config& cfg);
+    void close_socket();
+    bool receive_batch();
+    bool valid_datagram(const mmsghdr& msg) const;
+    inline unsigned char* rx_slot(std::size_t index)
+    {
+        return m_rx_buffers.data() + index * (header_size + m_max_packet_size);
+    }
+
+public:
+    virtual bool send_packet(const spw_packet& packet) final;
+    virtual std::size_t send_packets(const std::vector<spw_packet>& packets) final;
+    virtual spw_packet receive_packet() final;
+
+    virtual bool packet_received() final;
+    virtual bool set_configuration(const Config& cfg) final;
+    virtual Config configuration() const final;
+    UDPBridge(const Config& cfg);
+    virtual ~UDPBridge();
+};
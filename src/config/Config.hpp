@@ -23,11 +23,21 @@
 #include <dict.hpp>
 #include <filesystem>
 #include <iostream>
+#include <limits>
 #include "config/json_io.hpp"
 #include "config/yaml_io.hpp"
 
 using Config = cppdict::Dict<bool, int, double, std::string>;
 
+// YAML integers such as "speed: 10" are loaded as int, accepts them where a double is expected
+inline double to_double(Config node, double default_value)
+{
+    if (const auto value = node.to<int>(std::numeric_limits<int>::min());
+        value != std::numeric_limits<int>::min())
+        return value;
+    return node.to<double>(default_value);
+}
+
 
 inline Config from_json(const std::string& json)
 {
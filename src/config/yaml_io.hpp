@@ -41,7 +41,7 @@ enum class StringType
 inline StringType str_type(const std::string& data)
 {
     const std::regex float_regex { R"(^[-+]?[0-9]*\.?[0-9]+([eE][-+]?[0-9]+)?$)" };
-    const std::regex bool_regex { R"(^(bool)?|(true)?$)" };
+    const std::regex bool_regex { R"(^(true|false|True|False|TRUE|FALSE)$)" };
     const std::regex int_regex { R"(^[-+]?\d+$)" };
     if (std::regex_match(data, bool_regex))
         return StringType::Bool;
@@ -19,6 +19,7 @@
 /*--                  Author : Alexis Jeandet
 --                     Mail : alexis.jeandet@lpp.polytechnique.fr
 ----------------------------------------------------------------------------*/
+#include "BridgePlugins.hpp"
 #include "SpaceWireBridge.hpp"
 #include "SpaceWireBridges.hpp"
 #include "ZMQServer.hpp"
@@ -77,9 +78,11 @@ int main(int argc, char** argv)
         }
     }
 
+    BridgePlugins::setup(cfg["plugins"]);
     ZMQServer server { cfg["server"] };
     {
-        const auto _ = SpaceWireBridges::setup(cfg["bridges"], &server.received_packets);
+        const auto _ = SpaceWireBridges::setup(
+            cfg["bridges"], &server.received_packets, &server.received_events);
         server.loop();
     }
     return 0;
@@ -19,6 +19,9 @@
 #include <SpaceWirePP/rmap.hpp>
 #include <cassert>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <set>
 #include <vector>
 
 
@@ -53,6 +56,86 @@ spw_packet random_ccsds_packet()
     return packet;
 }
 
+spw_packet ccsds_packet(uint16_t apid)
+{
+    auto packet = random_ccsds_packet();
+    packet.data[topics::ccsds::primary_header_offset] = (apid >> 8) & 0x07;
+    packet.data[topics::ccsds::primary_header_offset + 1] = apid & 0xFF;
+    return packet;
+}
+
+TEST_CASE("CCSDS APID subscriptions", "[]")
+{
+    using namespace topics::ccsds;
+    REQUIRE(subscriptions({ 0x100, 0x1FF }) == std::vector<std::string> { "/CCSDS/1" });
+    REQUIRE(subscriptions({ 0x0FF, 0x101 })
+        == std::vector<std::string> { "/CCSDS/0FF/", "/CCSDS/100/", "/CCSDS/101/" });
+    REQUIRE(subscriptions({ 0x010, 0x02F })
+        == std::vector<std::string> { "/CCSDS/01", "/CCSDS/02" });
+    REQUIRE(subscriptions({ 0x010, 0x010, packet_type::TC })
+        == std::vector<std::string> { "/CCSDS/010/TC/" });
+    REQUIRE(to_topic(ccsds_packet(0x1AB).data.data(), 32) == "/CCSDS/1AB/TM/");
+}
+
+TEST_CASE("Protocol to topic table", "[]")
+{
+    using namespace topics;
+    static_assert(default_protocol_table[1].view() == strings::RMAP);
+    static_assert(default_protocol_table[2].type == types::CCSDS);
+    REQUIRE(default_protocol_table[0x4F].view() == "/RAW/4F/");
+    const auto table = load_protocol_table(from_yaml("MY_PROTO: 240"));
+    REQUIRE(table[240].view() == "/MY_PROTO/");
+    REQUIRE(table[240].custom);
+    REQUIRE(table[240].type == types::RAW);
+    REQUIRE(table[1].view() == strings::RMAP);
+}
+
+TEST_CASE("Endpoints", "[]")
+{
+    using namespace endpoints;
+    REQUIRE(binds(from_yaml("pub_port: 31000"), role::publisher)
+        == std::vector<std::string> { "tcp://127.0.0.1:31000" });
+    REQUIRE(binds(from_yaml("{ ipc: true, pub_port: 31000 }"), role::requests)
+        == std::vector<std::string> {
+            "tcp://127.0.0.1:30001", "ipc:///tmp/spacewirezmq-31000-req" });
+    REQUIRE(connect(from_yaml("transport: inproc"), role::publisher)
+        == "inproc://spacewirezmq-pub");
+    REQUIRE(connect(from_yaml("{ address: 10.0.0.1, ipc: true }"), role::publisher)
+        == "tcp://10.0.0.1:30000");
+    {
+        // socket file of a server that died
+        const auto stale = ipc_file(from_yaml("pub_port: 31500"), role::publisher);
+        std::ofstream { stale };
+        REQUIRE(connect(from_yaml("pub_port: 31500"), role::publisher)
+            == "tcp://127.0.0.1:31500");
+        remove_stale_ipc("ipc://" + stale);
+        REQUIRE_FALSE(std::filesystem::exists(stale));
+    }
+    const auto multi = from_yaml(R"(
+pub_endpoints:
+  lab: tcp://10.0.0.1:30000
+  local: ipc:///tmp/spacewirezmq-test-pub
+req_endpoints:
+  lab: tcp://10.0.0.1:30001
+)");
+    // named endpoints come in the configuration map order
+    const auto bound = binds(multi, role::publisher);
+    REQUIRE(std::set<std::string> { std::cbegin(bound), std::cend(bound) }
+        == std::set<std::string> { "tcp://10.0.0.1:30000", "ipc:///tmp/spacewirezmq-test-pub" });
+    REQUIRE(connect(multi, role::publisher) == "tcp://10.0.0.1:30000");
+    REQUIRE(connect(multi, role::requests) == "tcp://10.0.0.1:30001");
+    REQUIRE(wire_format(multi) == wire_format_t::serialized);
+    REQUIRE(wire_format(from_yaml("transport: inproc")) == wire_format_t::native);
+    const auto routed = multicast::routes(from_yaml(R"(
+multicast:
+  endpoint: "epgm://127.0.0.1;239.192.1.1:5555"
+  topics: { CCSDS: true }
+)"));
+    REQUIRE(routed[static_cast<std::size_t>(topics::types::CCSDS)]);
+    REQUIRE_FALSE(routed[static_cast<std::size_t>(topics::types::RMAP)]);
+    REQUIRE_FALSE(multicast::routes(from_yaml("topics: { CCSDS: true }"))[1]);
+}
+
 TEST_CASE("ZMQ Client", "[]")
 {
     std::vector<spw_packet> loopback_packets;
@@ -72,6 +155,20 @@ TEST_CASE("ZMQ Client", "[]")
             {
                 auto packets = client.get_packets();
                 REQUIRE(std::size(packets) == 10);
+                REQUIRE(client.statistics().missed == 0);
+            }
+        }
+        WHEN("RMAP packets are drained into a fixed size buffer")
+        {
+            10 * [&]() { client.send_packet(random_rmap_packet()); };
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should move at most the buffer size on each call")
+            {
+                std::array<spw_packet, 4> buffer;
+                REQUIRE(client.drain_into(std::begin(buffer), std::size(buffer)) == 4);
+                REQUIRE(client.drain_into(std::begin(buffer), std::size(buffer)) == 4);
+                REQUIRE(client.drain_into(std::begin(buffer), std::size(buffer)) == 2);
+                REQUIRE(client.drain_into(std::begin(buffer), std::size(buffer)) == 0);
             }
         }
         WHEN("CCSDS packets are published")
@@ -85,6 +182,58 @@ TEST_CASE("ZMQ Client", "[]")
             }
         }
     }
+    GIVEN("An RMAP only client without subscription thread")
+    {
+        ZMQClient client { { topics::types::RMAP }, server.configuration(),
+            topic_policy::merge_all_topics {}, threading_policy::on_demand {} };
+        WHEN("RMAP packets are published")
+        {
+            10 * [&]() { client.send_packet(random_rmap_packet()); };
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should read them from the socket when asked")
+            {
+                REQUIRE(client.has_packets());
+                REQUIRE(std::size(client.get_packets()) == 10);
+                REQUIRE_FALSE(client.has_packets());
+            }
+        }
+    }
+    GIVEN("An RMAP only client with a callback")
+    {
+        // declared first, the callback may still run while the client is destroyed
+        std::atomic<int> received { 0 };
+        ZMQClient client { { topics::types::RMAP }, server.configuration(),
+            topic_policy::merge_all_topics {} };
+        client.on_packet([&received](spw_packet&& packet) {
+            if (spacewire::rmap::is_rmap(packet.data.data()))
+                received++;
+        });
+        WHEN("RMAP packets are published")
+        {
+            10 * [&]() { client.send_packet(random_rmap_packet()); };
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should give them to the callback instead of queuing them")
+            {
+                REQUIRE(received == 10);
+                REQUIRE(std::size(client.get_packets()) == 0);
+            }
+        }
+    }
+    GIVEN("A client waiting for CCSDS packets")
+    {
+        ZMQClient client { { topics::types::RMAP, topics::types::CCSDS }, server.configuration(),
+            topic_policy::per_topic_queue {} };
+        WHEN("A CCSDS packet is published")
+        {
+            client.send_packet(ccsds_packet(0x42));
+            THEN("next_packet should return it")
+            {
+                const auto packet = client.next_packet(topics::types::CCSDS, 1s);
+                REQUIRE(packet.has_value());
+                REQUIRE(topics::ccsds::apid(packet->data.data()) == 0x42);
+            }
+        }
+    }
     GIVEN("An RMAP+CCSDS client with per topic queue")
     {
         ZMQClient client { { topics::types::RMAP, topics::types::CCSDS }, server.configuration(),
@@ -110,6 +259,95 @@ TEST_CASE("ZMQ Client", "[]")
             }
         }
     }
+    GIVEN("A RAW only client")
+    {
+        ZMQClient client { { topics::types::RAW }, server.configuration(),
+            topic_policy::merge_all_topics {} };
+        WHEN("packets with an unknown protocol ID are published")
+        {
+            10 * [&]() {
+                auto packet = random_ccsds_packet();
+                spacewire::fields::protocol_identifier(packet.data.data())
+                    = static_cast<spacewire::protocol_id_t>(0x42);
+                client.send_packet(packet);
+            };
+            10 * [&]() { client.send_packet(random_rmap_packet()); };
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should receive them and server should count them")
+            {
+                REQUIRE(std::size(client.get_packets()) == 10);
+                REQUIRE(server.statistics().unknown_protocol == 10);
+                REQUIRE(server.statistics().published == 20);
+                REQUIRE_FALSE(client.history(topics::types::RAW).has_value());
+            }
+        }
+    }
+    GIVEN("An EXTEND client")
+    {
+        ZMQClient client { { topics::types::EXTEND }, server.configuration(),
+            topic_policy::merge_all_topics {} };
+        auto extend_packet = []() {
+            spw_packet packet { 16, 0, "Mock" };
+            spacewire::fields::destination_logical_address(packet.data.data()) = 1;
+            return packet;
+        };
+        WHEN("The server drops a malformed packet between two published ones")
+        {
+            client.send_packet(extend_packet());
+            // too short to carry a protocol ID, EXTEND is protocol 0
+            client.send_packet(spw_packet { std::vector<unsigned char> { 1 }, 0, "Mock" });
+            client.send_packet(extend_packet());
+            std::this_thread::sleep_for(50ms);
+            THEN("Client shouldn't count it as a missing EXTEND packet")
+            {
+                REQUIRE(std::size(client.get_packets()) == 2);
+                REQUIRE(server.statistics().malformed == 1);
+                REQUIRE(client.statistics().missed == 0);
+                REQUIRE(client.statistics().missed_by_topic[static_cast<std::size_t>(
+                            topics::types::EXTEND)]
+                    == 0);
+            }
+        }
+    }
+    GIVEN("A client conflating CCSDS packets")
+    {
+        ZMQClient client { { topics::types::RMAP, topics::types::CCSDS },
+            from_yaml("conflate: { CCSDS: true }"), topic_policy::per_topic_queue {} };
+        WHEN("Several CCSDS packets per APID are published")
+        {
+            2 * [&]() { client.send_packet(ccsds_packet(0x42)); };
+            const auto latest = ccsds_packet(0x42);
+            client.send_packet(latest);
+            client.send_packet(ccsds_packet(0x43));
+            10 * [&]() { client.send_packet(random_rmap_packet()); };
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should only keep the latest packet of each APID")
+            {
+                REQUIRE(client.latest_packet(topics::ccsds::to_topic(0x42,
+                            topics::ccsds::packet_type::TM))
+                    == latest);
+                REQUIRE(client.latest_packet("/CCSDS/7FF/TM/") == std::nullopt);
+                REQUIRE(client.statistics().conflated == 2);
+                REQUIRE(std::size(client.get_packets(topics::types::CCSDS)) == 0);
+                REQUIRE(std::size(client.get_packets(topics::types::RMAP)) == 10);
+            }
+        }
+    }
+    GIVEN("A client subscribed to a CCSDS APID range")
+    {
+        ZMQClient client { { topics::ccsds::apid_range { 0x100, 0x1FF } },
+            server.configuration(), topic_policy::merge_all_topics {} };
+        WHEN("CCSDS packets from several APIDs are published")
+        {
+            for (uint16_t apid : { 0x0FF, 0x100, 0x180, 0x1FF, 0x200, 0x7FF })
+                client.send_packet(ccsds_packet(apid));
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should only receive packets within the APID range")
+            {
+                REQUIRE(std::size(client.get_packets()) == 3);
+            }
+        }
+    }
     GIVEN("An RMAP+CCSDS client with all topics in one queue")
     {
         ZMQClient client { { topics::types::RMAP, topics::types::CCSDS }, server.configuration(),
@@ -145,3 +383,150 @@ TEST_CASE("ZMQ Client", "[]")
     }
     server.close();
 }
+
+TEST_CASE("ZMQ Client history", "[]")
+{
+    ZMQServer server { from_yaml("history: { packets: 5 }") };
+    auto _ = SpaceWireBridges::setup(
+        config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
+    std::this_thread::sleep_for(5ms);
+    GIVEN("A client connected before packets are published")
+    {
+        ZMQClient client { { topics::types::RMAP, topics::types::CCSDS }, server.configuration(),
+            topic_policy::per_topic_queue {} };
+        std::vector<spw_packet> sent;
+        for (auto i = 0; i < 10; i++)
+        {
+            sent.push_back(ccsds_packet(i % 3 ? 0x001 : 0x7FF));
+            client.send_packet(sent.back());
+        }
+        std::this_thread::sleep_for(50ms);
+        REQUIRE(client.last_sequence(topics::types::CCSDS) == 10);
+        REQUIRE(client.last_sequence(topics::types::RMAP) == 0);
+        WHEN("A late client asks for the history")
+        {
+            ZMQClient late_client { { topics::types::CCSDS }, server.configuration(),
+                topic_policy::per_topic_queue {} };
+            THEN("It should get the last packets held by the server")
+            {
+                const auto all = late_client.history(topics::types::CCSDS);
+                REQUIRE(all.has_value());
+                REQUIRE(*all == std::vector<spw_packet>(std::cbegin(sent) + 5, std::cend(sent)));
+                const auto missed = late_client.history(topics::types::CCSDS, 8);
+                REQUIRE(
+                    *missed == std::vector<spw_packet>(std::cbegin(sent) + 8, std::cend(sent)));
+                REQUIRE(std::size(*late_client.history(topics::types::RMAP)) == 0);
+            }
+        }
+        WHEN("A client subscribed to other APIDs asks for the history")
+        {
+            ZMQClient apid_client { { topics::ccsds::apid_range { 0x7FF, 0x7FF } },
+                server.configuration(), topic_policy::per_topic_queue {} };
+            THEN("It should only get packets matching its subscriptions")
+            {
+                // packets 6 and 9 were sent to APID 0x7FF
+                REQUIRE(std::size(*apid_client.history(topics::types::CCSDS)) == 2);
+            }
+        }
+    }
+    server.close();
+}
+
+TEST_CASE("ZMQ bridge events", "[]")
+{
+    ZMQServer server { {} };
+    auto _ = SpaceWireBridges::setup(config_yaml::load_config<Config>(YML_Config),
+        &(server.received_packets), &(server.received_events));
+    GIVEN("A client subscribed to time-codes")
+    {
+        ZMQEventClient events { server.configuration(),
+            { std::string { events::topic(spw_event::kind_t::time_code) } } };
+        ZMQClient client { { topics::types::RAW }, server.configuration(),
+            topic_policy::merge_all_topics {} };
+        std::this_thread::sleep_for(5ms);
+        WHEN("The bridge gets a time-code")
+        {
+            client.send_packet(spw_packet { std::vector<unsigned char> { 2, 42 }, 1, "Mock" });
+            const auto event = events.next_event(1s);
+            THEN("The client should get it tagged with the bridge and port")
+            {
+                REQUIRE(event);
+                REQUIRE(event->kind == spw_event::kind_t::time_code);
+                REQUIRE(event->time_code == 42);
+                REQUIRE(event->port == 1);
+                REQUIRE(event->bridge_id == "Mock");
+                REQUIRE(event->timestamp_ns > 0);
+                REQUIRE(server.statistics().events == 1);
+            }
+        }
+    }
+    server.close();
+}
+
+TEST_CASE("ZMQ Client over inproc", "[]")
+{
+    ZMQServer server { from_yaml("transport: inproc") };
+    auto _ = SpaceWireBridges::setup(
+        config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
+    GIVEN("An RMAP+CCSDS client sharing the server context")
+    {
+        ZMQClient client { { topics::types::RMAP, topics::types::CCSDS }, server.configuration(),
+            server.context(), topic_policy::per_topic_queue {} };
+        WHEN("RMAP and CCSDS packets are published")
+        {
+            10 * [&]() { client.send_packet(random_rmap_packet()); };
+            const auto packet = ccsds_packet(0x123);
+            client.send_packet(packet);
+            std::this_thread::sleep_for(50ms);
+            THEN("Client should get them without serialization")
+            {
+                REQUIRE(std::size(client.get_packets(topics::types::RMAP)) == 10);
+                const auto ccsds_packets = client.get_packets(topics::types::CCSDS);
+                REQUIRE(std::size(ccsds_packets) == 1);
+                REQUIRE(ccsds_packets[0] == packet);
+            }
+        }
+    }
+    server.close();
+}
+
+TEST_CASE("ZMQ Client over multicast", "[]")
+{
+    if (!zmq_has("pgm"))
+    {
+        // Catch2 v2 has no skip, the warning shows in the report instead of a silent pass
+        WARN("libzmq built without PGM support, multicast test skipped");
+        return;
+    }
+    ZMQServer server { from_yaml(R"(
+multicast:
+  endpoint: "epgm://127.0.0.1;239.192.1.1:5555"
+  topics: { CCSDS: true }
+)") };
+    auto _ = SpaceWireBridges::setup(
+        config_yaml::load_config<Config>(YML_Config), &(server.received_packets));
+    std::this_thread::sleep_for(5ms);
+    GIVEN("Two RMAP+CCSDS clients")
+    {
+        ZMQClient first { { topics::types::RMAP, topics::types::CCSDS }, server.configuration(),
+            topic_policy::per_topic_queue {} };
+        ZMQClient second { { topics::types::RMAP, topics::types::CCSDS },
+            server.configuration(), topic_policy::per_topic_queue {} };
+        std::this_thread::sleep_for(50ms);
+        WHEN("RMAP and CCSDS packets are published")
+        {
+            10 * [&]() { first.send_packet(random_rmap_packet()); };
+            10 * [&]() { first.send_packet(random_ccsds_packet()); };
+            std::this_thread::sleep_for(100ms);
+            THEN("Both clients should get CCSDS packets from the group and RMAP ones over tcp")
+            {
+                for (auto* client : { &first, &second })
+                {
+                    REQUIRE(std::size(client->get_packets(topics::types::RMAP)) == 10);
+                    REQUIRE(std::size(client->get_packets(topics::types::CCSDS)) == 10);
+                }
+            }
+        }
+    }
+    server.close();
+}
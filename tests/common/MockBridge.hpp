@@ -31,11 +31,21 @@ static std::queue<spw_packet> loopback_packets;
 class MockBridge : public ISpaceWireBridge
 {
     char redirect_value { 0 };
+    // packets starting with this value make the bridge publish their second byte as time-code
+    int time_code_value { -1 };
 
 public:
     virtual bool send_packet(const spw_packet& packet) final
     {
         sent_packets.push_back(packet);
+        if (packet.size() >= 2 && packet.data[0] == time_code_value)
+        {
+            spw_event event;
+            event.kind = spw_event::kind_t::time_code;
+            event.port = packet.port;
+            event.time_code = packet.data[1];
+            publish_event(std::move(event));
+        }
         if (packet.data[0] == redirect_value)
             loopback_packets.push(packet);
         return true;
@@ -51,6 +61,7 @@ public:
     virtual bool set_configuration(const Config& cfg) final
     {
         redirect_value = cfg["redirect_value"].to<int>(0);
+        time_code_value = cfg["time_code_value"].to<int>(-1);
         return true;
     }
     virtual Config configuration() const final { return {}; }
@@ -59,12 +70,14 @@ public:
 };
 
 static auto t = SpaceWireBridges::register_ctor(
-    "Mock", [](const Config& cfg, packet_queue* publish_queue) {
-        return std::make_unique<SpaceWireBridge>(std::make_unique<MockBridge>(cfg), publish_queue);
+    "Mock", [](const std::string& name, const Config& cfg, packet_queue* publish_queue) {
+        return std::make_unique<SpaceWireBridge>(
+            std::make_unique<MockBridge>(cfg), publish_queue, name);
     });
 
 
 const auto YML_Config = std::string(R"(
 Mock:
   redirect_value: 1
+  time_code_value: 2
 )");
@@ -0,0 +1,66 @@
+#include "BridgePluginAdapter.hpp"
+#include "SpaceWireBridge.hpp"
+#include "config/Config.hpp"
+#include <deque>
+#include <mutex>
+
+/*
+ * Same loopback as loopback_bridge.cpp but written as an ISpaceWireBridge and exposed through
+ * bridge_plugin_adapter, the way STAR-Dundee is built.
+ */
+namespace
+{
+class AdaptedBridge : public ISpaceWireBridge
+{
+    Config m_cfg;
+    int m_time_code_port;
+    std::mutex m_mutex;
+    std::deque<spw_packet> m_packets;
+
+public:
+    AdaptedBridge(const Config& cfg) : m_cfg { cfg }
+    {
+        m_time_code_port = m_cfg["time_code_port"].to<int>(-1);
+    }
+
+    virtual bool send_packet(const spw_packet& packet) final
+    {
+        if (static_cast<int>(packet.port) == m_time_code_port && packet.size())
+        {
+            spw_event event;
+            event.kind = spw_event::kind_t::time_code;
+            event.port = packet.port;
+            event.time_code = packet.data[0];
+            publish_event(std::move(event));
+            return true;
+        }
+        std::lock_guard lock { m_mutex };
+        m_packets.push_back(packet);
+        return true;
+    }
+
+    virtual spw_packet receive_packet() final
+    {
+        std::lock_guard lock { m_mutex };
+        auto packet = std::move(m_packets.front());
+        m_packets.pop_front();
+        return packet;
+    }
+
+    virtual bool packet_received() final
+    {
+        std::lock_guard lock { m_mutex };
+        return !m_packets.empty();
+    }
+
+    virtual bool set_configuration(const Config&) final { return false; }
+    virtual Config configuration() const final { return m_cfg; }
+};
+
+const auto plugin = bridge_plugin_adapter<AdaptedBridge>::plugin("Adapted");
+}
+
+extern "C" const spw_bridge_plugin* spacewirezmq_bridge_plugin(void)
+{
+    return &plugin;
+}
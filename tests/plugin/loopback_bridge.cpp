@@ -0,0 +1,80 @@
+#include "BridgePlugin.h"
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/*
+ * Test bridge plugin looping back every packet it is sent, packets sent to port
+ * time_code_port are published as time-code events instead.
+ */
+namespace
+{
+struct loopback_bridge
+{
+    const spw_bridge_host* host;
+    int time_code_port;
+    std::mutex mutex;
+    std::deque<spw_bridge_packet> packets;
+    std::vector<unsigned char> storage;
+    std::deque<std::vector<unsigned char>> data;
+};
+
+void* create(const spw_bridge_host* host, const spw_bridge_config* config)
+{
+    return new loopback_bridge { host, host->config_int(config, "time_code_port", -1), {}, {},
+        {}, {} };
+}
+
+void destroy(void* bridge)
+{
+    delete static_cast<loopback_bridge*>(bridge);
+}
+
+int send_packet(void* bridge, const spw_bridge_packet* packet)
+{
+    auto self = static_cast<loopback_bridge*>(bridge);
+    if (static_cast<int>(packet->port) == self->time_code_port && packet->size)
+    {
+        spw_bridge_event event {};
+        event.kind = SPW_BRIDGE_EVENT_TIME_CODE;
+        event.time_code = packet->data[0];
+        event.port = packet->port;
+        self->host->publish_event(self->host->host_context, &event);
+        return 1;
+    }
+    std::lock_guard lock { self->mutex };
+    self->data.emplace_back(packet->data, packet->data + packet->size);
+    self->packets.push_back({ nullptr, packet->size, packet->port });
+    return 1;
+}
+
+int packet_received(void* bridge)
+{
+    auto self = static_cast<loopback_bridge*>(bridge);
+    std::lock_guard lock { self->mutex };
+    return !self->packets.empty();
+}
+
+int receive_packet(void* bridge, spw_bridge_packet* packet)
+{
+    auto self = static_cast<loopback_bridge*>(bridge);
+    std::lock_guard lock { self->mutex };
+    if (self->packets.empty())
+        return 0;
+    // data stays valid until the next call
+    self->storage = std::move(self->data.front());
+    self->data.pop_front();
+    *packet = self->packets.front();
+    packet->data = self->storage.data();
+    self->packets.pop_front();
+    return 1;
+}
+
+const spw_bridge_plugin plugin { SPW_BRIDGE_PLUGIN_ABI_VERSION, "Loopback", create, destroy,
+    send_packet, packet_received, receive_packet, nullptr };
+}
+
+extern "C" const spw_bridge_plugin* spacewirezmq_bridge_plugin(void)
+{
+    return &plugin;
+}
@@ -0,0 +1,102 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include "BridgePlugins.hpp"
+#include "PacketQueue.hpp"
+#include "SpaceWireBridges.hpp"
+#include "config/Config.hpp"
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+// a broken plugin fails the test at the deadline instead of hanging it
+template <typename Queue>
+auto take_before(Queue& queue, std::chrono::steady_clock::time_point deadline)
+{
+    while (!std::size(queue) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(50us);
+    return std::size(queue) ? queue.take() : std::nullopt;
+}
+
+TEST_CASE("Bridge plugins", "[]")
+{
+    GIVEN("A directory holding the loopback bridge plugin")
+    {
+        REQUIRE(BridgePlugins::setup(from_yaml("directory: " LOOPBACK_PLUGIN_DIR)) >= 1);
+        REQUIRE(SpaceWireBridges::has_ctor("Loopback"));
+        WHEN("A bridge instance of the plugin type is set up")
+        {
+            packet_queue packets;
+            event_queue events;
+            auto _ = SpaceWireBridges::setup(
+                from_yaml("Loopback-A: { time_code_port: 3 }"), &packets, &events);
+            SpaceWireBridges::send(spw_packet { std::vector<unsigned char> { 1, 2, 3 }, 1,
+                "Loopback-A" });
+            SpaceWireBridges::send(
+                spw_packet { std::vector<unsigned char> { 42 }, 3, "Loopback-A" });
+            const auto deadline = std::chrono::steady_clock::now() + 1s;
+            const auto packet = take_before(packets, deadline);
+            const auto event = take_before(events, deadline);
+            packets.close();
+            events.close();
+            THEN("Packets and events should go through the C ABI")
+            {
+                REQUIRE(packet);
+                REQUIRE(*packet
+                    == spw_packet { std::vector<unsigned char> { 1, 2, 3 }, 1, "Loopback-A" });
+                REQUIRE(event);
+                REQUIRE(event->kind == spw_event::kind_t::time_code);
+                REQUIRE(event->time_code == 42);
+                REQUIRE(event->bridge_id == "Loopback-A");
+            }
+        }
+    }
+    GIVEN("A C++ bridge built as a plugin through bridge_plugin_adapter")
+    {
+        REQUIRE(BridgePlugins::load(LOOPBACK_PLUGIN_DIR "/adapted_bridge.so"));
+        REQUIRE(SpaceWireBridges::has_ctor("Adapted"));
+        WHEN("A bridge instance of the plugin type is set up")
+        {
+            packet_queue packets;
+            event_queue events;
+            auto _ = SpaceWireBridges::setup(
+                from_yaml("Adapted-A: { time_code_port: 3 }"), &packets, &events);
+            SpaceWireBridges::send(spw_packet { std::vector<unsigned char> { 1, 2, 3 }, 1,
+                "Adapted-A" });
+            SpaceWireBridges::send(
+                spw_packet { std::vector<unsigned char> { 42 }, 3, "Adapted-A" });
+            const auto deadline = std::chrono::steady_clock::now() + 1s;
+            const auto packet = take_before(packets, deadline);
+            const auto event = take_before(events, deadline);
+            packets.close();
+            events.close();
+            THEN("Packets, events and the configuration should reach the C++ bridge")
+            {
+                REQUIRE(packet);
+                REQUIRE(*packet
+                    == spw_packet { std::vector<unsigned char> { 1, 2, 3 }, 1, "Adapted-A" });
+                REQUIRE(event);
+                REQUIRE(event->kind == spw_event::kind_t::time_code);
+                REQUIRE(event->time_code == 42);
+                REQUIRE(event->port == 3);
+                REQUIRE(event->bridge_id == "Adapted-A");
+            }
+        }
+    }
+    GIVEN("A file which isn't a plugin")
+    {
+        REQUIRE_FALSE(BridgePlugins::load("/nonexistent/bridge.so"));
+    }
+}
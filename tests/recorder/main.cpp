@@ -0,0 +1,132 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include "CaptureFile.hpp"
+#include "CaptureFormat.hpp"
+#include "Recorder.hpp"
+#include "config/Config.hpp"
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+namespace fs = std::filesystem;
+
+spw_packet ccsds_packet(std::size_t size, std::size_t port)
+{
+    spw_packet packet { size, port, "Mock" };
+    spacewire::fields::protocol_identifier(packet.data.data())
+        = spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS;
+    return packet;
+}
+
+TEST_CASE("Recorder", "[]")
+{
+    const auto directory = fs::temp_directory_path() / "spacewirezmq-recorder-test";
+    fs::remove_all(directory);
+    for (const auto direct_io : { "true", "false" })
+    {
+        GIVEN(std::string { "A recorder with direct_io: " } + direct_io)
+        {
+            Recorder recorder { from_yaml(fmt::format(
+                "{{ directory: {}, segment_mb: 1, buffer_mb: 1, flush_ms: 10, direct_io: {} }}",
+                directory.string(), direct_io)) };
+            WHEN("More packets than a segment holds are recorded")
+            {
+                for (auto i = 0UL; i < 3000; i++)
+                {
+                    // dropped packets are retried to get a deterministic capture
+                    while (!recorder.record(ccsds_packet(1000 + i % 7, i)))
+                        std::this_thread::sleep_for(1ms);
+                }
+                recorder.close();
+                THEN("Every packet should be found in the rotated segments")
+                {
+                    const auto stats = recorder.statistics();
+                    REQUIRE(stats.recorded == 3000);
+                    REQUIRE(stats.segments >= 2);
+                    CaptureFile capture { directory };
+                    REQUIRE(std::size(capture.segments()) == stats.segments);
+                    REQUIRE(std::size(capture) == 3000);
+                    uint64_t sequence = 0;
+                    uint64_t last_timestamp = 0;
+                    for (auto position = capture.begin(); auto packet = capture.read(position);)
+                    {
+                        REQUIRE(packet->sequence == sequence);
+                        REQUIRE(packet->bridge_id == "Mock");
+                        REQUIRE(packet->entry->protocol == 2);
+                        REQUIRE(packet->entry->bridge_hash == capture::bridge_hash("Mock"));
+                        REQUIRE(packet->timestamp_ns() >= last_timestamp);
+                        REQUIRE(packet->to_packet() == ccsds_packet(1000 + sequence % 7, sequence));
+                        last_timestamp = packet->timestamp_ns();
+                        sequence++;
+                    }
+                    REQUIRE(sequence == 3000);
+                }
+                AND_THEN("Packets can be found by sequence number and by time")
+                {
+                    CaptureFile capture { directory };
+                    auto position = capture.seek_sequence(2500);
+                    const auto packet = capture.read(position);
+                    REQUIRE(packet->sequence == 2500);
+                    REQUIRE(packet->entry->port == 2500);
+                    auto by_time = capture.seek(packet->timestamp_ns());
+                    REQUIRE(capture.read(by_time)->timestamp_ns() == packet->timestamp_ns());
+                    auto end = capture.seek(packet->timestamp_ns() + 3600'000'000'000UL);
+                    REQUIRE_FALSE(capture.read(end));
+                }
+                AND_THEN("A later recorder run should continue the sequence after them")
+                {
+                    {
+                        Recorder next_run { from_yaml(fmt::format(
+                            "{{ directory: {}, flush_ms: 10, direct_io: {} }}",
+                            directory.string(), direct_io)) };
+                        for (auto i = 3000UL; i < 3100; i++)
+                        {
+                            while (!next_run.record(ccsds_packet(1000 + i % 7, i)))
+                                std::this_thread::sleep_for(1ms);
+                        }
+                    }
+                    CaptureFile capture { directory };
+                    REQUIRE(std::size(capture) == 3100);
+                    uint64_t sequence = 0;
+                    for (auto position = capture.begin(); auto packet = capture.read(position);)
+                    {
+                        REQUIRE(packet->sequence == sequence);
+                        REQUIRE(packet->entry->port == sequence);
+                        sequence++;
+                    }
+                    auto position = capture.seek_sequence(3050);
+                    REQUIRE(capture.read(position)->entry->port == 3050);
+                }
+                AND_THEN("Segments without index should be read as well")
+                {
+                    for (const auto& entry : fs::directory_iterator { directory })
+                    {
+                        if (entry.path().extension() == ".idx")
+                            fs::remove(entry.path());
+                    }
+                    CaptureFile capture { directory };
+                    REQUIRE(std::size(capture) == 3000);
+                    auto position = capture.seek_sequence(1234);
+                    REQUIRE(capture.read(position)->entry->port == 1234);
+                }
+            }
+            fs::remove_all(directory);
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include "PacketQueue.hpp"
+#include "Recorder.hpp"
+#include "SpaceWireBridges.hpp"
+#include "config/Config.hpp"
+#include <SpaceWirePP/SpaceWire.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fmt/format.h>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+namespace fs = std::filesystem;
+
+spw_packet ccsds_packet(std::size_t size, std::size_t port)
+{
+    spw_packet packet { size, port, "Mock" };
+    spacewire::fields::protocol_identifier(packet.data.data())
+        = spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS;
+    return packet;
+}
+
+// records count packets spaced by period
+void record(const fs::path& directory, std::size_t count, std::chrono::milliseconds period)
+{
+    Recorder recorder { from_yaml(
+        fmt::format("{{ directory: {}, direct_io: false }}", directory.string())) };
+    for (auto i = 0UL; i < count; i++)
+    {
+        recorder.record(ccsds_packet(100 + i, i));
+        std::this_thread::sleep_for(period);
+    }
+}
+
+std::vector<spw_packet> replay(const fs::path& directory, const std::string& speed,
+    std::size_t count, std::chrono::milliseconds* duration = nullptr)
+{
+    packet_queue queue;
+    std::vector<spw_packet> packets;
+    const auto start = std::chrono::steady_clock::now();
+    {
+        auto _ = SpaceWireBridges::setup(from_yaml(fmt::format(
+                                             "Replay: {{ path: {}, speed: {} }}",
+                                             directory.string(), speed)),
+            &queue);
+        while (std::size(packets) < count)
+            packets.push_back(*queue.take());
+        if (duration)
+            *duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        queue.close();
+    }
+    return packets;
+}
+
+TEST_CASE("Replay bridge", "[]")
+{
+    const auto directory = fs::temp_directory_path() / "spacewirezmq-replay-test";
+    fs::remove_all(directory);
+    GIVEN("A capture of packets recorded every 20ms")
+    {
+        record(directory, 10, 20ms);
+        WHEN("It is replayed as fast as possible")
+        {
+            const auto packets = replay(directory, "0", 10);
+            THEN("Every packet should be published in order tagged with the Replay bridge")
+            {
+                for (auto i = 0UL; i < std::size(packets); i++)
+                {
+                    auto expected = ccsds_packet(100 + i, i);
+                    expected.bridge_id = "Replay";
+                    REQUIRE(packets[i] == expected);
+                }
+            }
+        }
+        WHEN("It is replayed by two named Replay bridges")
+        {
+            packet_queue queue;
+            std::vector<spw_packet> packets;
+            {
+                auto _ = SpaceWireBridges::setup(
+                    from_yaml(fmt::format("{{ Replay-A: {{ path: {0}, speed: 0 }}, "
+                                          "second: {{ type: Replay, path: {0}, speed: 0 }} }}",
+                        directory.string())),
+                    &queue);
+                while (std::size(packets) < 20)
+                    packets.push_back(*queue.take());
+                queue.close();
+            }
+            THEN("Both should publish every packet tagged with their own name")
+            {
+                for (const auto& name : { "Replay-A", "second" })
+                {
+                    REQUIRE(std::count_if(std::cbegin(packets), std::cend(packets),
+                                [&name](const auto& packet) { return packet.bridge_id == name; })
+                        == 10);
+                }
+            }
+        }
+        WHEN("It is replayed twice faster than recorded")
+        {
+            std::chrono::milliseconds duration;
+            const auto packets = replay(directory, "2.0", 10, &duration);
+            THEN("Replay should take about half of the recorded time")
+            {
+                REQUIRE(std::size(packets) == 10);
+                REQUIRE(duration >= 80ms);
+                REQUIRE(duration < 180ms);
+            }
+        }
+    }
+    fs::remove_all(directory);
+}
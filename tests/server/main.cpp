@@ -16,8 +16,11 @@
 #include "config/Config.hpp"
 #include "config/yaml_io.hpp"
 #include <SpaceWirePP/SpaceWire.hpp>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <thread>
 #include <vector>
 
 
@@ -56,3 +59,56 @@ TEST_CASE("ZMQ Server", "[]")
     REQUIRE(received_loopback_packets == loopback_packets);
     server.close();
 }
+
+TEST_CASE("Slow subscriber", "[]")
+{
+    ZMQServer server { from_yaml(
+        "{ pub_port: 30010, req_port: 30011, event_port: 30012, pub_sndhwm: 10 }") };
+    // subscribes to everything and never reads
+    zmq::context_t ctx;
+    zmq::socket_t slow { ctx, zmq::socket_type::sub };
+    slow.set(zmq::sockopt::rcvhwm, 10);
+    slow.set(zmq::sockopt::subscribe, "");
+    slow.connect(endpoints::connect(server.configuration(), endpoints::role::publisher));
+    std::this_thread::sleep_for(50ms);
+
+    // far more than both high-water marks and the TCP buffers hold
+    constexpr uint64_t count = 20000;
+    for (auto i = 0UL; i < count; i++)
+    {
+        spw_packet packet { 1024, 0, "Mock" };
+        spacewire::fields::protocol_identifier(packet.data.data())
+            = spacewire::protocol_id_t::SPW_PROTO_ID_CCSDS;
+        server.received_packets << std::move(packet);
+    }
+    const auto deadline = std::chrono::steady_clock::now() + 10s;
+    while (server.statistics().published < count && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    REQUIRE(server.statistics().published == count);
+    slow.close();
+    server.close();
+}
+
+TEST_CASE("Stalled event thread", "[]")
+{
+    // nobody takes from it, as if the server event thread were stuck
+    event_queue events;
+    MockBridge bridge { from_yaml("time_code_value: 2") };
+    bridge.set_event_queue(&events, "Mock");
+    constexpr std::size_t count = event_queue_capacity + 100;
+    std::atomic<std::size_t> sent { 0 };
+    std::thread driver { [&bridge, &sent]() {
+        for (auto i = 0UL; i < count; i++, sent++)
+            bridge.send_packet(spw_packet { std::vector<unsigned char> { 2, 42 }, 1, "Mock" });
+    } };
+    const auto deadline = std::chrono::steady_clock::now() + 1s;
+    while (sent < count && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(1ms);
+    const std::size_t sent_in_time = sent;
+    events.close();
+    driver.join();
+    // the time-code path must not wait for room, the overflow is counted instead
+    REQUIRE(sent_in_time == count);
+    REQUIRE(std::size(events) == event_queue_capacity);
+    REQUIRE(bridge.dropped_events() == count - event_queue_capacity);
+}
@@ -0,0 +1,74 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include "SPSCRing.hpp"
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+TEST_CASE("SPSC ring", "[]")
+{
+    GIVEN("A ring used from a single thread")
+    {
+        SPSCRing<std::unique_ptr<int>, 4> ring;
+        REQUIRE(ring.empty());
+        REQUIRE_FALSE(ring.pop());
+        THEN("it keeps values in order until full and counts overflows")
+        {
+            for (int i = 0; i < 4; i++)
+                REQUIRE(ring.push(std::make_unique<int>(i)));
+            REQUIRE(std::size(ring) == 4);
+            REQUIRE_FALSE(ring.push(std::make_unique<int>(4)));
+            REQUIRE_FALSE(ring.push(std::make_unique<int>(5)));
+            REQUIRE(ring.overflows() == 2);
+            for (int i = 0; i < 4; i++)
+                REQUIRE(**ring.pop() == i);
+            REQUIRE(ring.empty());
+            AND_THEN("it wraps around")
+            {
+                for (int i = 0; i < 10; i++)
+                {
+                    REQUIRE(ring.push(std::make_unique<int>(i)));
+                    REQUIRE(**ring.pop() == i);
+                }
+                REQUIRE(ring.overflows() == 2);
+            }
+        }
+    }
+    GIVEN("A producer and a consumer thread")
+    {
+        constexpr uint64_t count = 1000000;
+        SPSCRing<uint64_t, 1024> ring;
+        std::thread producer { [&ring]() {
+            for (uint64_t i = 0; i < count;)
+            {
+                if (ring.push(uint64_t { i }))
+                    i++;
+                else
+                    std::this_thread::yield();
+            }
+        } };
+        uint64_t expected = 0;
+        bool in_order = true;
+        while (expected < count)
+        {
+            if (auto value = ring.pop())
+                in_order &= (*value == expected++);
+            else
+                std::this_thread::yield();
+        }
+        producer.join();
+        THEN("every value is received once and in order")
+        {
+            REQUIRE(in_order);
+            REQUIRE(ring.empty());
+        }
+    }
+}
@@ -0,0 +1,106 @@
+#define CATCH_CONFIG_MAIN
+#if __has_include(<catch2/catch.hpp>)
+#include <catch2/catch.hpp>
+#include <catch2/catch_reporter_tap.hpp>
+#include <catch2/catch_reporter_teamcity.hpp>
+#else
+#include <catch.hpp>
+#include <catch_reporter_tap.hpp>
+#include <catch_reporter_teamcity.hpp>
+#endif
+#include "PacketQueue.hpp"
+#include "SpaceWireBridges.hpp"
+#include "bridges/UDPBridge.hpp"
+#include "config/Config.hpp"
+#include <chrono>
+#include <cstdint>
+#include <spdlog/spdlog.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+spw_packet numbered_packet(std::size_t index, const std::string& bridge_id)
+{
+    spw_packet packet { 16 + index % 64, index % 8, bridge_id };
+    for (auto i = 0UL; i < std::size(packet.data); i++)
+        packet.data[i] = static_cast<unsigned char>(index + i);
+    return packet;
+}
+
+// datagrams can be lost, gives up at the deadline instead of waiting forever
+bool wait_for(packet_queue& queue, std::vector<spw_packet>& received, std::size_t count,
+    std::chrono::steady_clock::time_point deadline)
+{
+    while (std::size(received) < count)
+    {
+        if (std::size(queue))
+            received.push_back(*queue.take());
+        else if (std::chrono::steady_clock::now() >= deadline)
+            return false;
+        else
+            std::this_thread::sleep_for(50us);
+    }
+    return true;
+}
+
+TEST_CASE("UDP bridge", "[]")
+{
+    // registered by a static initializer of the library, see "UDP bridge configuration"
+    REQUIRE(SpaceWireBridges::has_ctor("UDP"));
+    GIVEN("Two UDP bridges peered together on localhost")
+    {
+        packet_queue queue;
+        auto _ = SpaceWireBridges::setup(
+            from_yaml("{ UDP-A: { bind: '127.0.0.1:45501', peer: '127.0.0.1:45502' }, "
+                      "UDP-B: { bind: '127.0.0.1:45502', peer: '127.0.0.1:45501' } }"),
+            &queue);
+        std::this_thread::sleep_for(5ms);
+        WHEN("Packets are sent through the first one")
+        {
+            // bursts stay below the default loopback socket buffer
+            constexpr std::size_t burst = 200;
+            constexpr std::size_t bursts = 50;
+            std::vector<spw_packet> received;
+            const auto start = std::chrono::steady_clock::now();
+            for (auto b = 0UL; b < bursts; b++)
+            {
+                for (auto i = 0UL; i < burst; i++)
+                    SpaceWireBridges::send(numbered_packet(b * burst + i, "UDP-A"));
+                const bool complete = wait_for(queue, received, (b + 1) * burst, start + 10s);
+                INFO(std::size(received) << " of " << (b + 1) * burst << " packets received");
+                REQUIRE(complete);
+            }
+            const auto elapsed = std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start);
+            spdlog::info("UDP loopback: {:.0f} packets/s",
+                std::size(received) / elapsed.count());
+            THEN("The second one should publish all of them in order")
+            {
+                REQUIRE(std::size(received) == burst * bursts);
+                for (auto i = 0UL; i < std::size(received); i++)
+                {
+                    const auto expected = numbered_packet(i, "UDP-B");
+                    REQUIRE(received[i].port == expected.port);
+                    REQUIRE(received[i].data == expected.data);
+                    REQUIRE(received[i].bridge_id == "UDP-B");
+                }
+            }
+        }
+        queue.close();
+    }
+}
+
+/*
+ * Uses UDPBridge directly, which also keeps this test linked against libspacewirezmq even with
+ * as-needed linking, otherwise nothing would reference it and the UDP type never registered.
+ */
+TEST_CASE("UDP bridge configuration", "[]")
+{
+    UDPBridge bridge { from_yaml("{ bind: '127.0.0.1:45503', peer: '127.0.0.1:45504' }") };
+    REQUIRE(bridge.configuration()["bind"].to<std::string>("") == "127.0.0.1:45503");
+    // the bridge threads use the socket without locking
+    REQUIRE_FALSE(bridge.set_configuration(from_yaml("{ bind: '127.0.0.1:45505' }")));
+    REQUIRE(bridge.configuration()["bind"].to<std::string>("") == "127.0.0.1:45503");
+}
@@ -14,6 +14,7 @@
 const auto YML = std::string(R"(
 section1:
   key_bool: true
+  key_bool_false: false
   key_dict:
     key: value
   key_float: 1.11111
@@ -28,6 +29,7 @@ TEST_CASE("YAML to Dict", "[]")
     auto config = from_yaml(YML);
     REQUIRE(config["section1"]["key_string"].to<std::string>("") == "a string");
     REQUIRE(config["section1"]["key_bool"].to<bool>(false) == true);
+    REQUIRE(config["section1"]["key_bool_false"].to<bool>(true) == false);
     REQUIRE(config["section1"]["key_int"].to<int>(0) == 10);
     REQUIRE(config["section1"]["key_float"].to<double>(0.) == 1.11111);
     REQUIRE(config["section1"]["key_dict"]["key"].to<std::string>("") == "value");